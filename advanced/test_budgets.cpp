@@ -0,0 +1,53 @@
+#include "../test/scheme_test.h"
+
+#include <chrono>
+
+TEST_CASE("Budgets") {
+    Interpreter interpreter;
+    interpreter.Run("(define (loop x) (loop (+ x 1)))");
+    interpreter.Run("(define (fib x) (if (< x 3) 1 (+ (fib (- x 1)) (fib (- x 2)))))");
+
+    REQUIRE_THROWS_AS(interpreter.Run("(loop 0)", Budget{10000}), ResourceExhausted);
+    REQUIRE_THROWS_AS(interpreter.Run("(loop 0)", Budget{0, {}, 100}), ResourceExhausted);
+    REQUIRE_THROWS_AS(interpreter.Run("(fib 40)", Budget{0, std::chrono::milliseconds(20)}),
+                      ResourceExhausted);
+    REQUIRE_THROWS_AS(interpreter.Run("(touch (future (fib 40)))",
+                                      Budget{0, std::chrono::milliseconds(20)}),
+                      ResourceExhausted);
+
+    REQUIRE(interpreter.Run("(+ 1 2)", Budget{4}) == "3");
+    REQUIRE_THROWS_AS(interpreter.Run("(+ 1 2)", Budget{3}), ResourceExhausted);
+    REQUIRE(interpreter.Run("(fib 15)", Budget{1000000, std::chrono::seconds(10), 100}) == "610");
+    REQUIRE(interpreter.Run("(fib 10)") == "55");
+}
+
+TEST_CASE("BudgetsCoverFuturesAndParallelMaps") {
+    Interpreter interpreter;
+    interpreter.Run("(define (deep n) (if (= n 0) 0 (+ 1 (deep (- n 1)))))");
+
+    Budget shallow{0, std::chrono::seconds(10), 1000};
+    REQUIRE_THROWS_AS(interpreter.Run("(touch (future (deep 1000000)))", shallow),
+                      ResourceExhausted);
+    REQUIRE_THROWS_AS(interpreter.Run("(pmap deep '(1000000 1 2 3))", shallow),
+                      ResourceExhausted);
+    REQUIRE(interpreter.Run("(touch (future (deep 500)))", shallow) == "500");
+
+    // The futures and chunks draw on the fuel of the evaluation that started them.
+    REQUIRE_THROWS_AS(interpreter.Run("(touch (future (deep 3000)))", Budget{100}),
+                      ResourceExhausted);
+    REQUIRE_THROWS_AS(interpreter.Run("(pmap deep '(3000 3000 3000 3000))", Budget{100}),
+                      ResourceExhausted);
+    REQUIRE(interpreter.Run("(pmap deep '(30 30 30 30))", Budget{100000}) == "(30 30 30 30)");
+}
+
+TEST_CASE("GreenThreadsArePreempted") {
+    Interpreter interpreter;
+    interpreter.Run("(define (fib x) (if (< x 3) 1 (+ (fib (- x 1)) (fib (- x 2)))))");
+    interpreter.Run("(define c (make-channel))");
+    interpreter.Run("(define (busy) (fib 18) (channel-send c 1))");
+    interpreter.Run("(define (quick) (channel-send c 2))");
+    interpreter.Run("(define (start) (spawn busy) (spawn quick))");
+    interpreter.Run("(start)");
+    REQUIRE(interpreter.Run("(channel-recv c)") == "2");
+    REQUIRE(interpreter.Run("(channel-recv c)") == "1");
+}
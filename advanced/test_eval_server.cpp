@@ -0,0 +1,141 @@
+#include "../test/scheme_test.h"
+#include "../eval_server.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+int Connect(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    REQUIRE(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    return fd;
+}
+
+std::string Frame(const std::string& payload) {
+    uint32_t size = payload.size();
+    return std::string(reinterpret_cast<const char*>(&size), 4) + payload;
+}
+
+std::string ReadReply(int fd) {
+    uint32_t size;
+    REQUIRE(recv(fd, &size, 4, MSG_WAITALL) == 4);
+    std::string reply(size, '\0');
+    REQUIRE(recv(fd, reply.data(), size, MSG_WAITALL) == size);
+    return reply;
+}
+
+TEST_CASE("EvalServer") {
+    auto path = (std::filesystem::temp_directory_path() / "scheme_server_test.sock").string();
+    EvalServer server(path, [](Interpreter* interpreter) {
+        interpreter->Run("(define (sq x) (* x x))");
+    });
+    std::thread serving([&] { server.Serve(); });
+
+    // A path holding anything but a socket is left alone.
+    auto file = (std::filesystem::temp_directory_path() / "scheme_server_test.txt").string();
+    std::ofstream(file) << "data";
+    REQUIRE_THROWS_AS(EvalServer(file), RuntimeError);
+    REQUIRE(std::filesystem::file_size(file) == 4);
+    std::filesystem::remove(file);
+
+    int first = Connect(path);
+    int second = Connect(path);
+    auto requests = Frame("(define x 7)") + Frame("(sq x)") + Frame("(car 1)") + Frame("x");
+    // Split the pipelined requests mid-frame.
+    REQUIRE(send(first, requests.data(), 10, 0) == 10);
+    REQUIRE(send(first, requests.data() + 10, requests.size() - 10, 0) ==
+            static_cast<ssize_t>(requests.size() - 10));
+    auto probe = Frame("x");
+    REQUIRE(send(second, probe.data(), probe.size(), 0) == static_cast<ssize_t>(probe.size()));
+
+    REQUIRE(ReadReply(first) == std::string(1, '\0') + "7");
+    REQUIRE(ReadReply(first) == std::string(1, '\0') + "49");
+    REQUIRE(ReadReply(first)[0] == 1);
+    REQUIRE(ReadReply(first) == std::string(1, '\0') + "7");
+    REQUIRE(ReadReply(second)[0] == 1);
+
+    // Replies to requests sent right before the client stops writing still arrive.
+    auto last = Frame("(sq 12)");
+    REQUIRE(send(second, last.data(), last.size(), 0) == static_cast<ssize_t>(last.size()));
+    shutdown(second, SHUT_WR);
+    REQUIRE(ReadReply(second) == std::string(1, '\0') + "144");
+    char byte;
+    REQUIRE(recv(second, &byte, 1, 0) == 0);
+
+    close(first);
+    close(second);
+    server.Stop();
+    serving.join();
+}
+
+TEST_CASE("EvalServerBudget") {
+    auto path = (std::filesystem::temp_directory_path() / "scheme_budget_test.sock").string();
+    EvalServerOptions options;
+    options.spare_interpreters = 1;
+    options.budget = Budget{0, std::chrono::milliseconds(200), 1000};
+    options.memory_limit = 1 << 20;
+    EvalServer server(path, [](Interpreter* interpreter) {
+        interpreter->Run("(define (loop n) (loop (+ n 1)))");
+        interpreter->Run("(define (deep n) (if (= n 0) 0 (+ 1 (deep (- n 1)))))");
+    }, options);
+    std::thread serving([&] { server.Serve(); });
+
+    int client = Connect(path);
+    auto requests = Frame("(loop 0)") + Frame("(touch (future (deep 1000000)))") +
+                    Frame("(make-vector 1000000)") + Frame("(+ 1 2)");
+    REQUIRE(send(client, requests.data(), requests.size(), 0) ==
+            static_cast<ssize_t>(requests.size()));
+    REQUIRE(ReadReply(client)[0] == 1);
+    REQUIRE(ReadReply(client)[0] == 1);
+    REQUIRE(ReadReply(client)[0] == 1);
+    REQUIRE(ReadReply(client) == std::string(1, '\0') + "3");
+
+    close(client);
+    server.Stop();
+    serving.join();
+}
+
+TEST_CASE("EvalServerBackpressure") {
+    auto path = (std::filesystem::temp_directory_path() / "scheme_pressure_test.sock").string();
+    EvalServerOptions options;
+    options.spare_interpreters = 1;
+    options.max_queued_requests = 2;
+    options.max_output_bytes = 16;
+    EvalServer server(path, {}, options);
+    std::thread serving([&] { server.Serve(); });
+
+    // Far more requests and replies than the caps allow; the server reads on as replies drain.
+    int client = Connect(path);
+    std::string requests;
+    for (int i = 0; i < 200; ++i) {
+        requests += Frame("(+ " + std::to_string(i) + " 1)");
+    }
+    REQUIRE(send(client, requests.data(), requests.size(), 0) ==
+            static_cast<ssize_t>(requests.size()));
+    for (int i = 0; i < 200; ++i) {
+        REQUIRE(ReadReply(client) == std::string(1, '\0') + std::to_string(i + 1));
+    }
+    // Sessions accepted after the spare interpreter was taken get one built on a worker.
+    for (int i = 0; i < 3; ++i) {
+        int other = Connect(path);
+        auto request = Frame("(* 6 7)");
+        REQUIRE(send(other, request.data(), request.size(), 0) ==
+                static_cast<ssize_t>(request.size()));
+        REQUIRE(ReadReply(other) == std::string(1, '\0') + "42");
+        close(other);
+    }
+
+    close(client);
+    server.Stop();
+    serving.join();
+}
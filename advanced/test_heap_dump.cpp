@@ -0,0 +1,55 @@
+#include "../test/scheme_test.h"
+#include "../heap_dump.h"
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+TEST_CASE("HeapDump") {
+    auto path = (std::filesystem::temp_directory_path() / "scheme-heap-test").string();
+    Interpreter interpreter;
+    REQUIRE_THROWS_AS(interpreter.Run("(dump-heap '" + path + ")"), NameError);
+    interpreter.BindDumpHeap();
+    interpreter.Run("(define (range n) (if (= n 0) '() (cons n (range (- n 1)))))");
+    interpreter.Run("(define xs (range 100))");
+    interpreter.Run("(define ys (cons xs xs))");
+    auto objects = std::stoul(interpreter.Run("(dump-heap '" + path + ")"));
+
+    auto graph = ReadHeapDumpFile(path);
+    REQUIRE(graph.nodes.size() == objects);
+    REQUIRE(graph.strings[graph.nodes[0].type] == "Scope");
+    HeapAnalysis analysis(graph);
+    std::map<std::string, size_t> nodes;
+    size_t bytes = 0;
+    for (size_t node = 0; node < graph.nodes.size(); ++node) {
+        nodes[analysis.GetRootPath(node)] = node;
+        bytes += graph.nodes[node].bytes;
+    }
+    REQUIRE(analysis.GetRetainedSize(0) == bytes);
+    auto xs = nodes.at("xs.value");
+    // ys refers to the list too, so only the global scope dominates it.
+    REQUIRE(analysis.GetDominator(xs) == 0);
+    REQUIRE(analysis.GetDominator(nodes.at("xs.value.cdr")) == xs);
+    REQUIRE(analysis.GetRetainedSize(xs) > 100 * sizeof(Cell));
+    REQUIRE(analysis.GetRetainedSize(nodes.at("ys")) < analysis.GetRetainedSize(xs));
+    REQUIRE(analysis.GetTopRetainers(1) == std::vector<size_t>{xs});
+    auto range = graph.nodes[nodes.at("range")];
+    REQUIRE(graph.strings[range.type] == "Lambda");
+    REQUIRE(graph.strings[range.label] == "range");
+
+    interpreter.DumpHeap(path);
+    REQUIRE(ReadHeapDumpFile(path).nodes.size() == objects);
+    // A future allocates into a region of its own, which doesn't hold the global scope.
+    REQUIRE(interpreter.Run("(touch (future (dump-heap '" + path + ")))") ==
+            std::to_string(objects));
+    auto from_future = ReadHeapDumpFile(path);
+    REQUIRE(from_future.strings[from_future.nodes[0].type] == "Scope");
+    REQUIRE_THROWS_AS(ReadHeapDump("SCMH\x01\x05", 6), RuntimeError);
+    // One string "T" and two objects of that type without labels; the second one is reachable
+    // from the root only over the root's edge.
+    std::string reachable("SCMH\x01\x01\x01T\x02\x00\x08\x00\x01\x01\x00\x00\x08\x00\x00", 19);
+    REQUIRE(ReadHeapDump(reachable.data(), reachable.size()).nodes.size() == 2);
+    std::string unreachable("SCMH\x01\x01\x01T\x02\x00\x08\x00\x00\x00\x08\x00\x00", 17);
+    REQUIRE_THROWS_AS(ReadHeapDump(unreachable.data(), unreachable.size()), RuntimeError);
+}
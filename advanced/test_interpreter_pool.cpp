@@ -0,0 +1,28 @@
+#include "../test/scheme_test.h"
+#include "../interpreter_pool.h"
+
+#include <atomic>
+#include <string>
+
+TEST_CASE("InterpreterPool") {
+    std::atomic<int64_t> sum{0};
+    std::atomic<int> errors{0};
+    {
+        InterpreterPool pool(4, 8, [](Interpreter* interpreter) {
+            interpreter->Run("(define (sq x) (* x x))");
+        });
+        for (int i = 0; i < 200; ++i) {
+            pool.Submit("(sq " + std::to_string(i) + ")", [&](const JobResult& result) {
+                if (result.ok && result.worker < 4) {
+                    sum += std::stoll(result.output);
+                } else {
+                    ++errors;
+                }
+            });
+        }
+        pool.Submit("(sq", [&](const JobResult& result) { errors += !result.ok; });
+        pool.Wait();
+        REQUIRE(errors == 1);
+    }
+    REQUIRE(sum == 2646700);
+}
@@ -0,0 +1,73 @@
+#include "../test/scheme_test.h"
+
+#include <sys/resource.h>
+
+#include <string>
+#include <vector>
+
+TEST_CASE("MemoryLimit") {
+    Interpreter interpreter;
+    interpreter.Run("(define (range n) (if (= n 0) '() (cons n (range (- n 1)))))");
+    auto baseline = interpreter.GetHeapSize();
+    REQUIRE(baseline > 0);
+
+    interpreter.Run("(define small (range 100))");
+    auto with_small = interpreter.GetHeapSize();
+    REQUIRE(with_small > baseline + 100 * sizeof(Cell));
+
+    interpreter.SetMemoryLimit(with_small + (64 << 10));
+    REQUIRE_THROWS_AS(interpreter.Run("(range 100000)"), ResourceExhausted);
+    REQUIRE(interpreter.GetHeapSize() == with_small);
+    REQUIRE_THROWS_AS(interpreter.Run("(make-vector 100000)"), ResourceExhausted);
+    REQUIRE(interpreter.GetHeapSize() == with_small);
+    // The storage is charged before it is allocated, so the process never holds it.
+    auto max_resident = [] {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<size_t>(usage.ru_maxrss) << 10;
+    };
+    auto resident = max_resident();
+    REQUIRE_THROWS_AS(interpreter.Run("(make-vector 100000000 1)"), ResourceExhausted);
+    REQUIRE(max_resident() < resident + (100 << 20));
+    REQUIRE(interpreter.Run("(car small)") == "100");
+    REQUIRE(interpreter.Run("(car (range 10))") == "10");
+
+    interpreter.SetMemoryLimit(0);
+    REQUIRE(interpreter.Run("(car (range 10000))") == "10000");
+    REQUIRE(interpreter.GetHeapSize() == with_small);
+
+    auto stats = interpreter.GetHeapStats();
+    REQUIRE(stats.bytes == with_small);
+    REQUIRE(stats.peak_bytes > with_small + 10000 * sizeof(Cell));
+    interpreter.ResetPeakHeapSize();
+    interpreter.Run("(car small)");
+    REQUIRE(interpreter.GetHeapStats().peak_bytes < with_small + (64 << 10));
+    REQUIRE(interpreter.GetHeapStats().allocations > stats.allocations);
+}
+
+TEST_CASE("MemoryLimitCoversFutures") {
+    Interpreter interpreter;
+    interpreter.Run("(define (range n) (if (= n 0) '() (cons n (range (- n 1)))))");
+    interpreter.Run("(touch (future (car (range 2000))))");
+    auto baseline = interpreter.GetHeapSize();
+    interpreter.ResetPeakHeapSize();
+    interpreter.Run("(touch (future (car (range 2000))))");
+    auto per_future = interpreter.GetHeapStats().peak_bytes - baseline;
+
+    // Each future fits on its own, but their regions are charged to the interpreter's limit.
+    interpreter.SetMemoryLimit(baseline + per_future * 5 / 2);
+    std::vector<std::string> names{"a", "b", "c", "d"};
+    for (const auto& name : names) {
+        interpreter.Run("(define " + name + " (future (car (range 2000))))");
+    }
+    size_t failed = 0;
+    for (const auto& name : names) {
+        try {
+            interpreter.Run("(touch " + name + ")");
+        } catch (const ResourceExhausted&) {
+            ++failed;
+        }
+    }
+    REQUIRE(failed > 0);
+    REQUIRE(failed < names.size());
+}
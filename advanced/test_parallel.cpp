@@ -0,0 +1,62 @@
+#include "../test/scheme_test.h"
+
+TEST_CASE_METHOD(SchemeTest, "ParallelMap") {
+    ExpectNoError("(define (fib x) (if (< x 3) 1 (+ (fib (- x 1)) (fib (- x 2)))))");
+    ExpectEq("(pmap fib '(1 2 3 4 5 6 7 8 9 10))", "(1 1 2 3 5 8 13 21 34 55)");
+    ExpectEq("(pmap (lambda (x) (cons x x)) '(1 2))", "((1 . 1) (2 . 2))");
+    ExpectEq("(pmap abs '(-1 2 -3))", "(1 2 3)");
+    ExpectEq("(pmap fib '())", "()");
+
+    ExpectNoError("(define k 10)");
+    ExpectEq("(pmap (lambda (x) (* x k)) '(1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17))",
+             "(10 20 30 40 50 60 70 80 90 100 110 120 130 140 150 160 170)");
+    ExpectEq("(parallel-for-each fib '(1 2 3))", "()");
+}
+
+TEST_CASE_METHOD(SchemeTest, "ParallelMapErrors") {
+    ExpectRuntimeError("(pmap 1 '(1 2))");
+    ExpectRuntimeError("(pmap abs '(1 . 2))");
+    ExpectRuntimeError("(pmap abs)");
+    ExpectRuntimeError("(pmap car '(1 2 3 4 5 6 7 8 9 10 11 12))");
+    ExpectNameError("(pmap (lambda (x) y) '(1 2 3 4 5 6 7 8 9 10 11 12))");
+}
+
+TEST_CASE_METHOD(SchemeTest, "Futures") {
+    ExpectNoError("(define (fib x) (if (< x 3) 1 (+ (fib (- x 1)) (fib (- x 2)))))");
+    ExpectNoError("(define f (future (fib 15)))");
+    ExpectEq("f", "future");
+    ExpectEq("(touch f)", "610");
+    ExpectEq("(touch f)", "610");
+
+    ExpectEq("(touch (future (cons 1 (touch (future '(2 3))))))", "(1 2 3)");
+    ExpectNoError("(define g (future (car '())))");
+    ExpectRuntimeError("(touch g)");
+    ExpectNoError("(define h (future (fib 10)))");
+
+    // The outer futures finish at once; collections must wait for the inner ones.
+    ExpectNoError("(future (future (fib 22)))");
+    ExpectNoError("(define nested (future (future (fib 20))))");
+    for (int i = 0; i < 10; ++i) {
+        ExpectEq("(car (cons 1 2))", "1");
+    }
+    ExpectEq("(touch (touch nested))", "6765");
+
+    ExpectRuntimeError("(touch 1)");
+    ExpectSyntaxError("(future)");
+}
+
+TEST_CASE("ConcurrentEvaluationIsPerHeap") {
+    GarbageCollector heap;
+    GarbageCollector other;
+    GarbageCollector region;
+    GarbageCollector nested;
+    region.MakeRegionOf(heap);
+    nested.MakeRegionOf(region);
+    // Scopes of heap are locked while a future in nested runs; those of other are not.
+    nested.BeginConcurrentEvaluation();
+    REQUIRE(heap.IsEvaluatedConcurrently());
+    REQUIRE(region.IsEvaluatedConcurrently());
+    REQUIRE(!other.IsEvaluatedConcurrently());
+    nested.EndConcurrentEvaluation();
+    REQUIRE(!heap.IsEvaluatedConcurrently());
+}
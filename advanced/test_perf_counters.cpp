@@ -0,0 +1,22 @@
+#include "../test/scheme_test.h"
+#include "../perf_counters.h"
+
+TEST_CASE("PerfCounters") {
+    Interpreter interpreter;
+    interpreter.Run("(define (count n) (if (= n 0) 0 (count (- n 1))))");
+    PerfCounters counters;
+    counters.Start();
+    interpreter.Run("(count 1000)");
+    auto report = counters.Stop();
+    REQUIRE(report.cpu_time.count() > 0);
+    REQUIRE(report.wall_time.count() > 0);
+    // Hardware counters are optional: virtual machines rarely expose them.
+    if (report.instructions) {
+        REQUIRE(counters.HasHardwareCounters());
+        REQUIRE(*report.instructions > 1000);
+    }
+    REQUIRE(FormatPerfReport(report).rfind("wall-time ", 0) == 0);
+
+    auto result = interpreter.Run("(with-perf-counters (count 10))");
+    REQUIRE(result.rfind("((value . 0) (wall-time . ", 0) == 0);
+}
@@ -0,0 +1,34 @@
+#include "../test/scheme_test.h"
+#include "../process_pool.h"
+
+#include <string>
+#include <vector>
+
+TEST_CASE("ProcessPool") {
+    Interpreter prototype;
+    prototype.Run("(define (sq x) (* x x))");
+    prototype.Run("(define (loop x) (loop (+ x 1)))");
+    ProcessPool pool(&prototype, 2);
+    for (int i = 0; i < 20; ++i) {
+        pool.Submit("(sq " + std::to_string(i) + ")");
+    }
+    auto crash = pool.Submit("(loop 0)");
+    pool.Submit("(define y 1)");
+    pool.Submit("(sq 100)");
+
+    std::vector<JobResult> results(pool.Submit("(car 1)") + 1);
+    size_t id;
+    JobResult result;
+    while (pool.Next(&id, &result)) {
+        results[id] = result;
+    }
+    for (int i = 0; i < 20; ++i) {
+        REQUIRE(results[i].ok);
+        REQUIRE(results[i].output == std::to_string(i * i));
+    }
+    REQUIRE(!results[crash].ok);
+    REQUIRE(results[crash + 2].output == "10000");
+    REQUIRE(!results[crash + 3].ok);
+    REQUIRE(pool.Restarts() == 1);
+    REQUIRE_THROWS_AS(prototype.Run("y"), NameError);
+}
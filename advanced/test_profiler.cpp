@@ -0,0 +1,95 @@
+#include "../test/scheme_test.h"
+#include "../profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+TEST_CASE("SamplingProfiler") {
+    Interpreter interpreter;
+    interpreter.Run("(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+    interpreter.Run("(define run (lambda (n) (fib n)))");
+    interpreter.StartProfiling(std::chrono::microseconds(200));
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100)) {
+        REQUIRE(interpreter.Run("(run 15)") == "610");
+    }
+    auto stacks = interpreter.StopProfiling();
+    REQUIRE(stacks.rfind("run;fib;if;", 0) == 0);
+    REQUIRE(stacks.find(";+") != std::string::npos);
+    REQUIRE(stacks.back() == '\n');
+    REQUIRE(interpreter.StopProfiling().empty());
+
+    REQUIRE(interpreter.Run("(profile (fib 10))") == "55");
+}
+
+TEST_CASE("AllocationProfiler") {
+    Interpreter interpreter;
+    interpreter.Run("(define (range n) (if (= n 0) '() (cons n (range (- n 1)))))");
+    interpreter.Run("(define (churn n) (if (= n 0) 0 (churn (- n (car (range 3))))))");
+    interpreter.StartAllocationProfiling(1);
+    interpreter.Run("(define live (range 100))");
+    interpreter.Run("(churn 99)");
+
+    size_t live_cells = 0;
+    size_t garbage_cells = 0;
+    for (const auto& site : interpreter.GetAllocationSites(1000)) {
+        if (site.type != "Cell" || site.stack.find("range;if;cons") == std::string::npos) {
+            continue;
+        }
+        REQUIRE(site.collected == site.objects);
+        REQUIRE(site.bytes == site.objects * (sizeof(Cell) + sizeof(std::unique_ptr<Object>)));
+        if (site.stack.find("churn") == std::string::npos) {
+            REQUIRE(site.survived == site.collected);
+            live_cells += site.objects;
+        } else {
+            REQUIRE(site.survived == 0);
+            garbage_cells += site.objects;
+        }
+    }
+    REQUIRE(live_cells == 100);
+    REQUIRE(garbage_cells == 33 * 3);
+
+    auto report = interpreter.StopAllocationProfiling(5);
+    REQUIRE(std::count(report.begin(), report.end(), '\n') == 6);
+    REQUIRE(interpreter.GetAllocationSites(5).empty());
+}
+
+TEST_CASE("BuiltinStats") {
+    Interpreter interpreter;
+    interpreter.Run("(define (sum n) (if (= n 0) 0 (+ n (sum (- n 1)))))");
+    interpreter.Run("(sum 10)");
+    REQUIRE(interpreter.GetBuiltinStats().empty());
+
+    interpreter.SetBuiltinStats(true);
+    REQUIRE(interpreter.Run("(sum 10)") == "55");
+    std::map<std::string, BuiltinCounters> counters;
+    for (const auto& entry : interpreter.GetBuiltinStats()) {
+        counters[entry.name] = entry;
+    }
+    REQUIRE(counters.at("if").calls == 11);
+    REQUIRE(counters.at("=").calls == 11);
+    REQUIRE(counters.at("+").calls == 10);
+    REQUIRE(counters.at("+").arguments == 20);
+    // The difference and the Variable looking n up.
+    REQUIRE(counters.at("-").allocations == 20);
+    // + waits for the recursive call, but that time is not its own.
+    REQUIRE(counters.at("+").time > counters.at("+").self_time);
+    REQUIRE(counters.count("sum") == 0);
+
+    REQUIRE(interpreter.Run("(builtin-stats #f)") == "#t");
+    interpreter.Run("(sum 10)");
+    for (const auto& entry : interpreter.GetBuiltinStats()) {
+        if (entry.name != "builtin-stats") {
+            REQUIRE(entry.calls == counters.at(entry.name).calls);
+        }
+    }
+    interpreter.ResetBuiltinStats();
+    REQUIRE(interpreter.Run("(builtin-stats #t)") == "#f");
+    interpreter.Run("(car '(1))");
+    REQUIRE(interpreter.Run("(builtin-stats)").find("(car (calls . 1) (arguments . 1) (") !=
+            std::string::npos);
+    REQUIRE_THROWS_AS(interpreter.Run("(builtin-stats 1)"), RuntimeError);
+}
@@ -0,0 +1,36 @@
+#include "../test/scheme_test.h"
+#include "../telemetry.h"
+
+#include <string>
+
+TEST_CASE("RuntimeStats") {
+    Interpreter interpreter;
+    interpreter.Run("(define (range n) (if (= n 0) '() (cons n (range (- n 1)))))");
+    interpreter.Run("(define xs (range 10))");
+    REQUIRE_THROWS_AS(interpreter.Run("(car 1)"), RuntimeError);
+    auto before = interpreter.GetStats();
+    REQUIRE(before.runs == 3);
+    REQUIRE(before.failed_runs == 1);
+    REQUIRE(before.heap.collections == 3);
+    REQUIRE(before.heap.mark_time.GetCount() == 3);
+    REQUIRE(before.objects.at("Cell") >= 10);
+    REQUIRE(before.objects.at("Lambda") == 1);
+
+    interpreter.Run("(+ 1 2)");
+    auto after = interpreter.GetStats();
+    // The call, its head and its two arguments.
+    REQUIRE(after.steps - before.steps == 4);
+    REQUIRE(after.run_time.GetCount() == 4);
+    REQUIRE(after.heap.bytes_allocated > before.heap.bytes_allocated);
+    REQUIRE(interpreter.Run("(list-ref (gc-stats) 4)") == "(collections . 4)");
+
+    auto text = FormatPrometheus(interpreter.GetStats());
+    REQUIRE(text.find("\nscheme_runs_total 5\n") != std::string::npos);
+    REQUIRE(text.find("\nscheme_run_seconds_count 5\n") != std::string::npos);
+    REQUIRE(text.find("scheme_heap_objects{type=\"Lambda\"} 1\n") != std::string::npos);
+
+    RuntimeStats odd{};
+    odd.objects["a\"b\\c\nd"] = 2;
+    text = FormatPrometheus(odd);
+    REQUIRE(text.find("scheme_heap_objects{type=\"a\\\"b\\\\c\\nd\"} 2\n") != std::string::npos);
+}
@@ -0,0 +1,65 @@
+#include "../test/scheme_test.h"
+#include "../message_channel.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("SharedChannels") {
+    MessageChannel small(3);
+    REQUIRE(small.Capacity() == 4);
+    for (int i = 0; i < 4; ++i) {
+        auto message = Pack(nullptr);
+        REQUIRE(small.TrySend(&message));
+    }
+    auto message = Pack(nullptr);
+    REQUIRE(!small.TrySend(&message));
+
+    auto requests = std::make_shared<MessageChannel>(4);
+    auto results = std::make_shared<MessageChannel>(4);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 3; ++i) {
+        workers.emplace_back([&] {
+            Interpreter interpreter;
+            interpreter.BindChannel("in", requests);
+            interpreter.BindChannel("out", results);
+            interpreter.Run("(define (serve) (handle (channel-recv in)))");
+            interpreter.Run("(define (handle x) (if (= x 0) 0 (reply x)))");
+            interpreter.Run("(define (reply x) (channel-send out (cons x '(a #t))) (serve))");
+            interpreter.Run("(serve)");
+        });
+    }
+
+    Interpreter interpreter;
+    interpreter.BindChannel("in", requests);
+    interpreter.BindChannel("out", results);
+    REQUIRE(interpreter.Run("in") == "channel");
+    for (int i = 1; i <= 30; ++i) {
+        interpreter.Run("(channel-send in " + std::to_string(i) + ")");
+        auto result = interpreter.Run("(channel-recv out)");
+        REQUIRE(result == "(" + std::to_string(i) + " a #t)");
+    }
+    for (int i = 0; i < 3; ++i) {
+        interpreter.Run("(channel-send in 0)");
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    REQUIRE_THROWS_AS(interpreter.Run("(channel-send in (lambda (x) x))"), RuntimeError);
+    interpreter.Run("(define x '(1 2))");
+    // Printing a cyclic list wouldn't end either, so only its first element is returned.
+    interpreter.Run("(car (set-cdr! (cdr x) x))");
+    REQUIRE_THROWS_AS(interpreter.Run("(channel-send in x)"), RuntimeError);
+    interpreter.Run("(define v (make-vector 1))");
+    interpreter.Run("(car (vector-set! v 0 (cons 1 v)))");
+    REQUIRE_THROWS_AS(interpreter.Run("(channel-send in v)"), RuntimeError);
+    interpreter.Run("(define y '(3))");
+    interpreter.Run("(channel-send in (cons y y))");
+    REQUIRE(interpreter.Run("(channel-recv in)") == "((3) 3)");
+    // Shared pairs are sent once, so a tree with 2^40 leaves stays a list of 40 pairs.
+    interpreter.Run("(define (dup x n) (if (= n 0) x (dup (cons x x) (- n 1))))");
+    interpreter.Run("(define (depth x) (if (number? x) 0 (+ 1 (depth (car x)))))");
+    interpreter.Run("(channel-send in (dup 1 40))");
+    REQUIRE(interpreter.Run("(depth (channel-recv in))") == "40");
+}
@@ -0,0 +1,48 @@
+#include "../test/scheme_test.h"
+#include "../functions.h"
+#include "../shared_environment.h"
+
+#include <memory>
+
+TEST_CASE("SharedEnvironment") {
+    auto base = std::make_shared<const SharedEnvironment>(
+        "(define limit 10) (define data '(1 2)) (define (clamp x) (min x limit)) "
+        "(define table (make-hash-table)) (hash-table-set! table 'a 1) "
+        "(define counter 0) (define (bump) (set! counter (+ counter 1)) counter) "
+        "(define anonymous (cons (lambda (x) x) 1))");
+    Interpreter first(base);
+    Interpreter second(base);
+
+    REQUIRE(first.Run("(clamp 42)") == "10");
+    REQUIRE_THROWS_AS(first.Run("(set! limit 5)"), RuntimeError);
+    REQUIRE_THROWS_AS(first.Run("(bump)"), RuntimeError);
+    REQUIRE_THROWS_AS(first.Run("(set! car cdr)"), RuntimeError);
+    REQUIRE(first.Run("counter") == "0");
+    REQUIRE(first.Run("(car '(1 2))") == "1");
+
+    // A definition shadows the shared binding for the interpreter's own code only; the
+    // prelude's closures keep seeing the shared one.
+    REQUIRE(first.Run("(define limit 5)") == "5");
+    REQUIRE(first.Run("(set! limit 6)") == "6");
+    REQUIRE(first.Run("limit") == "6");
+    REQUIRE(second.Run("limit") == "10");
+    REQUIRE(first.Run("(clamp 42)") == "10");
+
+    REQUIRE(first.Run("(define abs (lambda (x) 0))") == "Lambda function");
+    REQUIRE(first.Run("(abs -3)") == "0");
+    REQUIRE(second.Run("(abs -3)") == "3");
+
+    REQUIRE_THROWS_AS(first.Run("(set-car! data 3)"), RuntimeError);
+    REQUIRE_THROWS_AS(first.Run("(hash-table-set! table 'a 2)"), RuntimeError);
+    REQUIRE(second.Run("(hash-table-ref table 'a)") == "1");
+    REQUIRE(first.Run("(define mine (cons 1 2))") == "(1 . 2)");
+    REQUIRE(first.Run("(set-car! mine 3)") == "3");
+    REQUIRE_THROWS_AS(first.Run("(set! missing 1)"), NameError);
+    REQUIRE(second.Run("data") == "(1 2)");
+
+    // Naming a shared lambda would race with the other interpreters.
+    REQUIRE(first.Run("(define id (car anonymous))") == "Lambda function");
+    REQUIRE(As<Lambda>(first.GetGlobalScope()->Get("id"))->name_ == nullptr);
+    REQUIRE(first.Run("(define own (lambda (x) x))") == "Lambda function");
+    REQUIRE(As<Lambda>(first.GetGlobalScope()->Get("own"))->name_ != nullptr);
+}
@@ -0,0 +1,35 @@
+#include "../test/scheme_test.h"
+
+#include <filesystem>
+#include <fstream>
+
+TEST_CASE("SnapshotRestoresGlobalScope") {
+    auto path = (std::filesystem::temp_directory_path() / "scheme_snapshot_test").string();
+    {
+        Interpreter interpreter;
+        interpreter.Run("(define (fib x) (if (< x 3) 1 (+ (fib (- x 1)) (fib (- x 2)))))");
+        interpreter.Run("(define lst '(1 2 . 3))");
+        interpreter.Run("(define vec (vector 1 lst #(x)))");
+        interpreter.Run("(define table (make-hash-table))");
+        interpreter.Run("(hash-table-set! table 'name lst)");
+        interpreter.Run("(hash-table-set! table 7 table)");
+        interpreter.Run("(define (counter x) (lambda () (set! x (+ x 1)) x))");
+        interpreter.Run("(define next (counter 10))");
+        interpreter.Run("(next)");
+        interpreter.SaveSnapshot(path);
+    }
+    Interpreter interpreter;
+    interpreter.LoadSnapshot(path);
+    REQUIRE(interpreter.Run("(fib 10)") == "55");
+    REQUIRE(interpreter.Run("lst") == "(1 2 . 3)");
+    REQUIRE(interpreter.Run("vec") == "#(1 (1 2 . 3) #(x))");
+    REQUIRE(interpreter.Run("(hash-table-ref table 'name)") == "(1 2 . 3)");
+    REQUIRE(interpreter.Run("(hash-table-count (hash-table-ref table 7))") == "2");
+    REQUIRE(interpreter.Run("(next)") == "12");
+    REQUIRE(interpreter.Run("(car (cons #t #f))") == "#t");
+
+    std::ofstream(path, std::ios::binary) << "SCMS\x63";
+    REQUIRE_THROWS_AS(interpreter.LoadSnapshot(path), RuntimeError);
+    REQUIRE(interpreter.Run("(fib 10)") == "55");
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,45 @@
+#include "../test/scheme_test.h"
+#include "../tracer.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+TEST_CASE("Tracer") {
+    auto path = (std::filesystem::temp_directory_path() / "scheme_trace_test.json").string();
+    Interpreter interpreter;
+    interpreter.Run("(define (sq x) (* x x))");
+    {
+        TraceOptions options;
+        options.lambda_threshold = std::chrono::nanoseconds(0);
+        Tracer tracer(path, options);
+        std::filesystem::remove(path + ".other");
+        REQUIRE_THROWS_AS(Tracer(path + ".other"), RuntimeError);
+        REQUIRE(!std::filesystem::exists(path + ".other"));
+        // The file of the live tracer is left alone.
+        REQUIRE_THROWS_AS(Tracer(path), RuntimeError);
+        REQUIRE(interpreter.Run("(sq 7)") == "49");
+        std::thread other([&] { Interpreter().Run("((lambda (x) x) 1)"); });
+        other.join();
+        REQUIRE(tracer.GetDroppedEvents() == 0);
+    }
+    std::ifstream in(path);
+    std::string trace((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    REQUIRE(trace.rfind("{\"traceEvents\":[", 0) == 0);
+    REQUIRE(trace.substr(trace.size() - 3) == "]}\n");
+    for (auto event : {"\"name\":\"Read\",\"cat\":\"parse\"", "\"name\":\"Evaluate\"",
+                       "\"name\":\"sq\",\"cat\":\"lambda\"", "\"name\":\"lambda\"",
+                       "\"name\":\"Mark\",\"cat\":\"gc\"", "\"name\":\"Sweep\""}) {
+        REQUIRE(trace.find(event) != std::string::npos);
+    }
+
+    TraceOptions tiny;
+    tiny.buffer_events = 2;
+    tiny.flush_interval = std::chrono::seconds(10);
+    Tracer tracer(path, tiny);
+    interpreter.Run("(sq 1)");
+    REQUIRE(tracer.GetDroppedEvents() > 0);
+}
@@ -12,3 +12,38 @@ TEST_CASE_METHOD(SchemeTest, "Be careful") {
     ExpectRuntimeError("('() ())");
     ExpectEq("'(())", "(())");
 }
+
+TEST_CASE("ParseCache") {
+    Interpreter interpreter;
+    interpreter.SetParseCacheCapacity(2);
+
+    REQUIRE(interpreter.Run("(define x '(1 . 2))") == "(1 . 2)");
+    REQUIRE(interpreter.Run("(set-car! x 5)") == "5");
+    REQUIRE(interpreter.Run("(define x '(1 . 2))") == "(1 . 2)");
+    REQUIRE(interpreter.Run("(car x)") == "1");
+
+    auto stats = interpreter.GetParseCacheStats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 3);
+    REQUIRE(stats.size == 2);
+
+    REQUIRE_THROWS_AS(interpreter.Run("(1 . 2 3)"), SyntaxError);
+    REQUIRE(interpreter.GetParseCacheStats().size == 2);
+
+    // Vector literals are copied on a hit too; the code around them is shared.
+    REQUIRE(interpreter.Run("(define v #(1 2))") == "#(1 2)");
+    REQUIRE(interpreter.Run("(vector-set! v 0 5)") == "5");
+    REQUIRE(interpreter.Run("(define v #(1 2))") == "#(1 2)");
+    REQUIRE(interpreter.Run("v") == "#(1 2)");
+    // Shared lists keep their source locations.
+    for (int i = 0; i < 2; ++i) {
+        REQUIRE_THROWS_WITH(interpreter.Run("(1 2)"), Catch::Contains("<input>:1:1"));
+    }
+
+    // Code of evicted entries lives on while a lambda refers to it.
+    interpreter.Run("(define (inc x) (+ x 1))");
+    interpreter.Run("(inc 1)");
+    interpreter.Run("(inc 2)");
+    interpreter.Run("(inc 3)");
+    REQUIRE(interpreter.Run("(inc 41)") == "42");
+}
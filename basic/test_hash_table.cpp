@@ -0,0 +1,96 @@
+#include "../test/scheme_test.h"
+
+TEST_CASE_METHOD(SchemeTest, "HashTablePredicate") {
+    ExpectEq("(hash-table? (make-hash-table))", "#t");
+    ExpectEq("(hash-table? #(1))", "#f");
+    ExpectEq("(hash-table? '())", "#f");
+    ExpectEq("(make-hash-table)", "hash table");
+    ExpectRuntimeError("(make-hash-table 1)");
+}
+
+TEST_CASE_METHOD(SchemeTest, "HashTableAccess") {
+    ExpectNoError("(define t (make-hash-table))");
+    ExpectEq("(hash-table-count t)", "0");
+    ExpectEq("(hash-table-set! t 1 'one)", "one");
+    ExpectEq("(hash-table-set! t 'two 2)", "2");
+    ExpectEq("(hash-table-set! t '() 'nil)", "nil");
+    ExpectEq("(hash-table-ref t 1)", "one");
+    ExpectEq("(hash-table-ref t 'two)", "2");
+    ExpectEq("(hash-table-ref t '())", "nil");
+    ExpectEq("(hash-table-count t)", "3");
+
+    ExpectEq("(hash-table-set! t 1 'uno)", "uno");
+    ExpectEq("(hash-table-ref t 1)", "uno");
+    ExpectEq("(hash-table-count t)", "3");
+
+    ExpectEq("(hash-table-contains? t 'two)", "#t");
+    ExpectEq("(hash-table-contains? t 'three)", "#f");
+    ExpectEq("(hash-table-ref t 'three 0)", "0");
+    ExpectEq("(hash-table-ref t 1 (car '()))", "uno");
+    ExpectRuntimeError("(hash-table-ref t 'three)");
+
+    ExpectEq("(hash-table-delete! t 'two)", "#t");
+    ExpectEq("(hash-table-delete! t 'two)", "#f");
+    ExpectEq("(hash-table-contains? t 'two)", "#f");
+    ExpectEq("(hash-table-count t)", "2");
+
+    ExpectRuntimeError("(hash-table-ref '(1) 1)");
+    ExpectRuntimeError("(hash-table-set! #(1) 0 1)");
+    ExpectRuntimeError("(hash-table-count)");
+}
+
+TEST_CASE_METHOD(SchemeTest, "HashTableKeys") {
+    ExpectNoError("(define t (make-hash-table))");
+    ExpectNoError("(hash-table-set! t (+ 40 2) 'number)");
+    ExpectNoError("(hash-table-set! t 'sym 'symbol)");
+    ExpectNoError("(hash-table-set! t #t 'true)");
+    ExpectEq("(hash-table-ref t 42)", "number");
+    ExpectEq("(hash-table-ref t (quote sym))", "symbol");
+    ExpectEq("(hash-table-ref t (= 1 1))", "true");
+    ExpectEq("(hash-table-contains? t #f)", "#f");
+    ExpectEq("(hash-table-contains? t -42)", "#f");
+
+    // Pairs and vectors are keys only for themselves.
+    ExpectNoError("(define key (cons 1 2))");
+    ExpectNoError("(hash-table-set! t key 'pair)");
+    ExpectEq("(hash-table-ref t key)", "pair");
+    ExpectEq("(hash-table-contains? t (cons 1 2))", "#f");
+    ExpectEq("(hash-table-contains? t t)", "#f");
+}
+
+TEST_CASE_METHOD(SchemeTest, "HashTableToAlist") {
+    ExpectEq("(hash-table->alist (make-hash-table))", "()");
+    ExpectNoError("(define t (make-hash-table))");
+    ExpectNoError("(hash-table-set! t 'a 1)");
+    ExpectEq("(hash-table->alist t)", "((a . 1))");
+}
+
+TEST_CASE_METHOD(SchemeTest, "HashTableGrowsAndShrinks") {
+    ExpectNoError("(define t (make-hash-table))");
+    ExpectNoError("(define (fill i) (if (= i 500) (hash-table-count t) (fill-next i)))");
+    ExpectNoError("(define (fill-next i) (hash-table-set! t i (* i i)) (fill (+ i 1)))");
+    ExpectEq("(fill 0)", "500");
+    ExpectEq("(hash-table-ref t 499)", "249001");
+
+    // Deleting every other key moves the following entries back over the holes.
+    ExpectNoError("(define (drop i) (if (>= i 500) (hash-table-count t) (drop-next i)))");
+    ExpectNoError("(define (drop-next i) (hash-table-delete! t i) (drop (+ i 2)))");
+    ExpectEq("(drop 0)", "250");
+    ExpectNoError("(define (check i) (if (>= i 500) #t (check-next i)))");
+    ExpectNoError(
+        "(define (check-next i) (if (and (not (hash-table-contains? t (- i 1))) "
+        "(= (hash-table-ref t i) (* i i))) (check (+ i 2)) i))");
+    ExpectEq("(check 1)", "#t");
+    ExpectEq("(fill 0)", "500");
+}
+
+TEST_CASE_METHOD(SchemeTest, "HashTablesSurviveCollection") {
+    ExpectNoError("(define t (make-hash-table))");
+    ExpectNoError("(hash-table-set! t 'pair (cons 1 2))");
+    ExpectNoError("(define u (make-hash-table))");
+    ExpectNoError("(hash-table-set! u (cons 3 4) 'key)");
+    ExpectNoError("(define (garbage n) (if (= n 0) 0 (garbage (- n 1))))");
+    ExpectNoError("(garbage 1000)");
+    ExpectEq("(hash-table-ref t 'pair)", "(1 . 2)");
+    ExpectEq("(hash-table->alist u)", "(((3 . 4) . key))");
+}
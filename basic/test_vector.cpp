@@ -0,0 +1,59 @@
+#include "../test/scheme_test.h"
+
+TEST_CASE_METHOD(SchemeTest, "VectorLiterals") {
+    ExpectEq("#(1 2 3)", "#(1 2 3)");
+    ExpectEq("#()", "#()");
+    ExpectEq("#(1 (2 . 3) #(a))", "#(1 (2 . 3) #(a))");
+    ExpectEq("'#(x y)", "#(x y)");
+    ExpectSyntaxError("#(1 . 2)");
+    ExpectSyntaxError("#(1");
+}
+
+TEST_CASE_METHOD(SchemeTest, "VectorPredicate") {
+    ExpectEq("(vector? #(1))", "#t");
+    ExpectEq("(vector? '(1))", "#f");
+    ExpectEq("(vector? 1)", "#f");
+}
+
+TEST_CASE_METHOD(SchemeTest, "VectorConstructors") {
+    ExpectEq("(vector)", "#()");
+    ExpectEq("(vector 1 (+ 1 1) '() 'a)", "#(1 2 () a)");
+    ExpectEq("(make-vector 3 7)", "#(7 7 7)");
+    ExpectEq("(make-vector 2)", "#(() ())");
+    ExpectEq("(make-vector 0)", "#()");
+    ExpectRuntimeError("(make-vector -1)");
+    ExpectRuntimeError("(make-vector 'a)");
+    ExpectRuntimeError("(make-vector)");
+}
+
+TEST_CASE_METHOD(SchemeTest, "VectorAccess") {
+    ExpectNoError("(define v (make-vector 3 0))");
+    ExpectEq("(vector-length v)", "3");
+    ExpectEq("(vector-set! v 1 'x)", "x");
+    ExpectEq("(vector-ref v 1)", "x");
+    ExpectEq("v", "#(0 x 0)");
+
+    ExpectRuntimeError("(vector-ref v 3)");
+    ExpectRuntimeError("(vector-ref v -1)");
+    ExpectRuntimeError("(vector-ref v 'a)");
+    ExpectRuntimeError("(vector-ref '(1 2) 0)");
+    ExpectRuntimeError("(vector-set! v 3 0)");
+    ExpectRuntimeError("(vector-length '())");
+}
+
+TEST_CASE_METHOD(SchemeTest, "VectorConversions") {
+    ExpectEq("(vector->list #(1 2 3))", "(1 2 3)");
+    ExpectEq("(vector->list #())", "()");
+    ExpectEq("(list->vector '(1 2 3))", "#(1 2 3)");
+    ExpectEq("(list->vector '())", "#()");
+    ExpectRuntimeError("(list->vector '(1 . 2))");
+}
+
+TEST_CASE_METHOD(SchemeTest, "VectorsSurviveCollection") {
+    ExpectNoError("(define v (make-vector 100 0))");
+    ExpectNoError("(define (fill i) (if (= i 100) v (begin-fill i)))");
+    ExpectNoError("(define (begin-fill i) (vector-set! v i (cons i i)) (fill (+ i 1)))");
+    ExpectNoError("(fill 0)");
+    ExpectEq("(vector-ref v 42)", "(42 . 42)");
+    ExpectEq("(vector-ref v 99)", "(99 . 99)");
+}
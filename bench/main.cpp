@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../garbage_collector.h"
+#include "../parser.h"
+#include "../scheme.h"
+
+using Clock = std::chrono::steady_clock;
+
+class Workload {
+public:
+    virtual ~Workload() = default;
+
+    // One operation; its time, allocations and heap size are what a case reports.
+    virtual void Run() = 0;
+
+    virtual HeapStats GetStats() const = 0;
+
+    virtual void ResetPeak() = 0;
+
+    // Input bytes one operation consumes, for throughput; 0 if it doesn't apply.
+    virtual size_t GetInputBytes() const {
+        return 0;
+    }
+};
+
+// Evaluates expr in an interpreter prepared by the setup forms.
+class SchemeWorkload : public Workload {
+public:
+    SchemeWorkload(const std::vector<std::string>& setup, const std::string& expr) : expr_{expr} {
+        for (const auto& form : setup) {
+            interpreter_.Run(form);
+        }
+    }
+
+    void Run() override {
+        interpreter_.Run(expr_);
+    }
+
+    HeapStats GetStats() const override {
+        return interpreter_.GetHeapStats();
+    }
+
+    void ResetPeak() override {
+        interpreter_.ResetPeakHeapSize();
+    }
+
+private:
+    Interpreter interpreter_;
+    std::string expr_;
+};
+
+// Parses the source into a heap of its own, which is emptied after every operation.
+class ParseWorkload : public Workload {
+public:
+    ParseWorkload(std::string source) : source_{std::move(source)} {
+    }
+
+    void Run() override {
+        ActiveGC guard(&gc_);
+        ReadAll(source_);
+        gc_.ClearAll();
+    }
+
+    HeapStats GetStats() const override {
+        return gc_.GetStats();
+    }
+
+    void ResetPeak() override {
+        gc_.ResetPeak();
+    }
+
+    size_t GetInputBytes() const override {
+        return source_.size();
+    }
+
+private:
+    std::string source_;
+    GarbageCollector gc_;
+};
+
+// Top-level definitions with nested lists, numbers and symbols, about size bytes in total.
+std::string GenerateSource(size_t size) {
+    std::string source;
+    for (size_t i = 0; source.size() < size; ++i) {
+        auto n = std::to_string(i);
+        source += "(define (f" + n + " x y)\n  (if (< x y) (+ x " + n + " (* y 2))\n" +
+                  "      (cons 'sym" + n + " (list 1 2 3 (- x y) '(a b (c . d))))))\n";
+    }
+    return source;
+}
+
+const std::vector<std::string> kRange = {
+    "(define (range n) (if (= n 0) '() (cons n (range (- n 1)))))"};
+
+struct Case {
+    std::string name;
+    std::unique_ptr<Workload> (*make)();
+};
+
+const std::vector<Case> kCases = {
+    {"fib",
+     [] {
+         return std::unique_ptr<Workload>(new SchemeWorkload(
+             {"(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))"}, "(fib 15)"));
+     }},
+    {"tak",
+     [] {
+         return std::unique_ptr<Workload>(new SchemeWorkload(
+             {"(define (tak x y z) (if (not (< y x)) z (tak (tak (- x 1) y z) "
+              "(tak (- y 1) z x) (tak (- z 1) x y))))"},
+             "(tak 12 8 4)"));
+     }},
+    {"ackermann",
+     [] {
+         return std::unique_ptr<Workload>(new SchemeWorkload(
+             {"(define (ack m n) (if (= m 0) (+ n 1) (if (= n 0) (ack (- m 1) 1) "
+              "(ack (- m 1) (ack m (- n 1))))))"},
+             "(ack 2 9)"));
+     }},
+    {"list-sort",
+     [] {
+         auto setup = kRange;
+         // Lists passed around are never empty: an empty list can't be bound to a parameter.
+         setup.push_back(
+             "(define (insert x xs) (if (< x (car xs)) (cons x xs) (if (null? (cdr xs)) "
+             "(cons (car xs) (cons x '())) (cons (car xs) (insert x (cdr xs))))))");
+         setup.push_back(
+             "(define (sort xs) (if (null? (cdr xs)) (cons (car xs) '()) "
+             "(insert (car xs) (sort (cdr xs)))))");
+         setup.push_back("(define data (range 60))");
+         return std::unique_ptr<Workload>(new SchemeWorkload(setup, "(car (sort data))"));
+     }},
+    {"deep-recursion",
+     [] {
+         return std::unique_ptr<Workload>(new SchemeWorkload(
+             {"(define (depth n) (if (= n 0) 0 (+ 1 (depth (- n 1)))))"}, "(depth 5000)"));
+     }},
+    {"closures",
+     [] {
+         return std::unique_ptr<Workload>(new SchemeWorkload(
+             {"(define (make-adder n) (lambda (x) (+ x n)))",
+              "(define (compose f g) (lambda (x) (f (g x))))",
+              "(define (chain n f) (if (= n 0) f (chain (- n 1) (compose f (make-adder n)))))"},
+             "((chain 300 (make-adder 0)) 0)"));
+     }},
+    {"parse",
+     [] { return std::unique_ptr<Workload>(new ParseWorkload(GenerateSource(64 << 10))); }},
+    {"gc-stress",
+     [] {
+         // Every operation leaves a short list of garbage behind and the collection after it
+         // marks a long live one.
+         auto setup = kRange;
+         setup.push_back("(define live (range 3000))");
+         setup.push_back("(define (churn n) (if (= n 0) 0 (churn (- n (car (range 20))))))");
+         return std::unique_ptr<Workload>(new SchemeWorkload(setup, "(churn 2000)"));
+     }},
+};
+
+struct Result {
+    std::string name;
+    size_t iterations;
+    double ns_per_op;
+    double allocations_per_op;
+    size_t peak_heap_bytes;
+    double bytes_per_second;
+};
+
+// Runs batches of doubling size until min_time has passed, after one warm-up operation.
+Result Measure(const std::string& name, Workload* workload, std::chrono::nanoseconds min_time) {
+    workload->Run();
+    workload->ResetPeak();
+    auto before = workload->GetStats();
+    size_t iterations = 0;
+    std::chrono::nanoseconds elapsed{0};
+    auto start = Clock::now();
+    for (size_t batch = 1; elapsed < min_time; batch *= 2) {
+        for (size_t i = 0; i < batch; ++i) {
+            workload->Run();
+        }
+        iterations += batch;
+        elapsed = Clock::now() - start;
+    }
+    auto after = workload->GetStats();
+
+    Result result;
+    result.name = name;
+    result.iterations = iterations;
+    result.ns_per_op = static_cast<double>(elapsed.count()) / iterations;
+    result.allocations_per_op =
+        static_cast<double>(after.allocations - before.allocations) / iterations;
+    result.peak_heap_bytes = after.peak_bytes;
+    result.bytes_per_second = workload->GetInputBytes() * 1e9 / result.ns_per_op;
+    return result;
+}
+
+void PrintJson(const std::vector<Result>& results) {
+    std::cout << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "%s\n    {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.1f, "
+                      "\"allocations_per_op\": %.1f, \"peak_heap_bytes\": %zu",
+                      i ? "," : "", r.name.c_str(), r.iterations, r.ns_per_op,
+                      r.allocations_per_op, r.peak_heap_bytes);
+        std::cout << line;
+        if (r.bytes_per_second > 0) {
+            std::snprintf(line, sizeof(line), ", \"bytes_per_second\": %.0f", r.bytes_per_second);
+            std::cout << line;
+        }
+        std::cout << "}";
+    }
+    std::cout << "\n  ]\n}\n";
+}
+
+void PrintTable(const std::vector<Result>& results) {
+    std::printf("%-16s %12s %14s %14s %14s\n", "case", "iterations", "ns/op", "allocs/op",
+                "peak heap");
+    for (const auto& r : results) {
+        std::printf("%-16s %12zu %14.0f %14.1f %14zu", r.name.c_str(), r.iterations, r.ns_per_op,
+                    r.allocations_per_op, r.peak_heap_bytes);
+        if (r.bytes_per_second > 0) {
+            std::printf("  %.1f MB/s", r.bytes_per_second / (1 << 20));
+        }
+        std::printf("\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    bool json = false;
+    std::string filter;
+    std::chrono::milliseconds min_time{500};
+    for (int arg = 1; arg < argc; ++arg) {
+        if (std::strcmp(argv[arg], "--json") == 0) {
+            json = true;
+        } else if (std::strcmp(argv[arg], "--filter") == 0 && arg + 1 < argc) {
+            filter = argv[++arg];
+        } else if (std::strcmp(argv[arg], "--min-time-ms") == 0 && arg + 1 < argc) {
+            min_time = std::chrono::milliseconds(std::atoi(argv[++arg]));
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--json] [--filter NAME] [--min-time-ms N]\n";
+            return 1;
+        }
+    }
+
+    std::vector<Result> results;
+    for (const auto& c : kCases) {
+        if (c.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        try {
+            auto workload = c.make();
+            results.push_back(Measure(c.name, workload.get(), min_time));
+        } catch (const std::exception& e) {
+            std::cerr << c.name << ": " << e.what() << "\n";
+            return 1;
+        }
+    }
+    if (json) {
+        PrintJson(results);
+    } else {
+        PrintTable(results);
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "budget.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "error.h"
+#include "green_threads.h"
+#include "profiler.h"
+
+namespace {
+// Steps between two checks: about a few tens of microseconds of evaluation.
+constexpr int64_t kCheckInterval = 1024;
+// Samples are recorded at checks, which come more often while profiling to keep them on time.
+constexpr int64_t kProfiledCheckInterval = 64;
+}  // namespace
+
+thread_local int64_t steps_until_check = kCheckInterval;
+thread_local BudgetGuard::State BudgetGuard::state;
+
+void CheckBudget() {
+    RecordDueSamples();
+    auto& state = BudgetGuard::state;
+    if (state.has_deadline && std::chrono::steady_clock::now() > state.deadline) {
+        steps_until_check = 0;
+        throw ResourceExhausted("Evaluation ran out of time");
+    }
+    int64_t batch = IsProfiling() ? kProfiledCheckInterval : kCheckInterval;
+    if (state.fuel) {
+        // Futures and parallel maps of the evaluation take their batches from the same pool.
+        auto left = state.fuel->load();
+        uint64_t taken;
+        do {
+            if (left == 0) {
+                steps_until_check = 0;
+                throw ResourceExhausted("Evaluation ran out of fuel");
+            }
+            taken = std::min<uint64_t>(batch, left);
+        } while (!state.fuel->compare_exchange_weak(left, left - taken));
+        batch = taken;
+    }
+    // The check runs before the step that used it up, which is charged here.
+    steps_until_check = batch - 1;
+    state.steps_handed += batch;
+    // Green threads are preempted at the same points, so a busy one can't starve the others.
+    auto scheduler = GetGreenScheduler();
+    if (scheduler && scheduler->Current() && scheduler->HasReady()) {
+        scheduler->Yield();
+    }
+}
+
+BudgetGuard::BudgetGuard(const Budget& budget) : saved_{state}, saved_steps_{steps_until_check} {
+    state = State{};
+    if (budget.fuel > 0) {
+        state.fuel = std::make_shared<std::atomic<uint64_t>>(budget.fuel);
+    }
+    state.has_deadline = budget.time.count() > 0;
+    state.deadline = std::chrono::steady_clock::now() + budget.time;
+    state.max_depth = budget.depth;
+    // The first step triggers a check, which hands out the first batch.
+    steps_until_check = 0;
+}
+
+BudgetGuard::BudgetGuard(const InheritedBudget& inherited) : BudgetGuard(inherited.budget) {
+    state.fuel = inherited.fuel;
+    state.depth = saved_.depth;
+    if (saved_.max_depth > 0 &&
+        (state.max_depth == 0 || saved_.max_depth < state.max_depth)) {
+        state.max_depth = saved_.max_depth;
+    }
+}
+
+BudgetGuard::~BudgetGuard() {
+    // Steps taken from a shared pool but not evaluated go back for the other threads.
+    if (state.fuel && steps_until_check > 0) {
+        *state.fuel += steps_until_check;
+        state.steps_handed -= steps_until_check;
+        steps_until_check = 0;
+    }
+    auto steps = GetSteps();
+    state = saved_;
+    steps_until_check = saved_steps_;
+    state.steps_handed += steps;
+}
+
+InheritedBudget BudgetGuard::Inherited() {
+    InheritedBudget inherited;
+    if (state.has_deadline) {
+        inherited.budget.time = std::max(state.deadline - std::chrono::steady_clock::now(),
+                                         std::chrono::steady_clock::duration(1));
+    }
+    inherited.budget.depth = state.max_depth;
+    inherited.fuel = state.fuel;
+    return inherited;
+}
+
+uint64_t BudgetGuard::GetSteps() {
+    return state.steps_handed - steps_until_check;
+}
+
+CallDepthGuard::CallDepthGuard() {
+    auto& state = BudgetGuard::state;
+    ++state.depth;
+    if (state.max_depth > 0 && state.depth > state.max_depth) {
+        --state.depth;
+        throw ResourceExhausted("Evaluation nested too deeply");
+    }
+}
+
+CallDepthGuard::~CallDepthGuard() {
+    --BudgetGuard::state.depth;
+}
+
+CallDepthLimit::CallDepthLimit(size_t max_depth) : saved_{BudgetGuard::state.max_depth} {
+    if (saved_ == 0 || max_depth < saved_) {
+        BudgetGuard::state.max_depth = max_depth;
+    }
+}
+
+CallDepthLimit::~CallDepthLimit() {
+    BudgetGuard::state.max_depth = saved_;
+}
+
+size_t ExchangeCallDepth(size_t depth) {
+    return std::exchange(BudgetGuard::state.depth, depth);
+}
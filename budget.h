@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Limits of one evaluation, zero meaning unlimited. Running out of any of them throws
+// ResourceExhausted; everything the evaluation allocated is collected by the next Run.
+struct Budget {
+    // Evaluation steps, i.e. calls of CalcExpression.
+    uint64_t fuel{0};
+    // Wall-clock time. Futures and parallel maps started by the evaluation inherit the deadline.
+    std::chrono::nanoseconds time{0};
+    // Nested lambda calls, to fail cleanly long before the native stack overflows.
+    size_t depth{0};
+};
+
+// Steps are counted down in batches; the budget proper is checked once a batch is used up.
+extern thread_local int64_t steps_until_check;
+
+void CheckBudget();
+
+inline void ChargeStep() {
+    if (--steps_until_check < 0) {
+        CheckBudget();
+    }
+}
+
+// Limits an evaluation hands to the work it starts on other threads (futures, parallel maps):
+// its deadline and depth limit, and its fuel, which they all draw from.
+struct InheritedBudget {
+    Budget budget;
+    // Steps left to the evaluation and everything it started; nullptr without a fuel limit.
+    std::shared_ptr<std::atomic<uint64_t>> fuel;
+};
+
+// While alive, applies budget to the evaluations on the current thread.
+class BudgetGuard {
+public:
+    BudgetGuard(const Budget& budget);
+
+    // The calls already on the native stack count against the depth limit, which is also kept
+    // under that of the enclosing guard: a thread waiting for a future may run it itself.
+    BudgetGuard(const InheritedBudget& inherited);
+
+    ~BudgetGuard();
+
+    BudgetGuard(const BudgetGuard&) = delete;
+
+    BudgetGuard& operator=(const BudgetGuard&) = delete;
+
+    // Budget for work handed to another thread: the time left until the current deadline, the
+    // depth limit and the fuel left.
+    static InheritedBudget Inherited();
+
+    // Steps evaluated on the current thread since the innermost guard was created, including
+    // those of the guards nested in it.
+    static uint64_t GetSteps();
+
+private:
+    struct State {
+        std::shared_ptr<std::atomic<uint64_t>> fuel;
+        std::chrono::steady_clock::time_point deadline;
+        bool has_deadline{false};
+        size_t max_depth{0};
+        size_t depth{0};
+        // Steps of all batches handed out; those left in the current one are not taken yet.
+        uint64_t steps_handed{0};
+    };
+
+    friend void CheckBudget();
+    friend class CallDepthGuard;
+    friend class CallDepthLimit;
+    friend size_t ExchangeCallDepth(size_t depth);
+
+    static thread_local State state;
+
+    State saved_;
+    int64_t saved_steps_;
+};
+
+// Counts one nested lambda call against the depth limit while alive.
+class CallDepthGuard {
+public:
+    CallDepthGuard();
+
+    ~CallDepthGuard();
+};
+
+// While alive, keeps the depth limit of the current thread at most max_depth: green threads run on
+// stacks much smaller than that of the thread.
+class CallDepthLimit {
+public:
+    explicit CallDepthLimit(size_t max_depth);
+
+    ~CallDepthLimit();
+
+    CallDepthLimit(const CallDepthLimit&) = delete;
+
+    CallDepthLimit& operator=(const CallDepthLimit&) = delete;
+
+private:
+    size_t saved_;
+};
+
+// Replaces the call depth of the current thread. Green threads keep their own depth, which is
+// swapped in whenever they are switched to.
+size_t ExchangeCallDepth(size_t depth);
@@ -20,3 +20,10 @@ struct NameError : public std::runtime_error {
     NameError(const std::string& s) : std::runtime_error(s) {
     }
 };
+
+// Thrown when an evaluation runs out of the budget it was given (see Budget).
+struct ResourceExhausted : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+    ResourceExhausted(const std::string& s) : std::runtime_error(s) {
+    }
+};
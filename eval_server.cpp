@@ -0,0 +1,404 @@
+#include "eval_server.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <utility>
+
+#include "error.h"
+#include "scheduler.h"
+
+namespace {
+// Larger requests close the connection instead of buffering without bound.
+constexpr uint32_t kMaxFrame = 16 << 20;
+constexpr size_t kReadChunk = 64 << 10;
+constexpr int kMaxEvents = 64;
+
+void AppendFrame(char status, const std::string& payload, std::string* out) {
+    uint32_t size = payload.size() + 1;
+    for (int i = 0; i < 4; ++i) {
+        out->push_back(static_cast<char>(size >> (8 * i)));
+    }
+    out->push_back(status);
+    out->append(payload);
+}
+
+uint32_t GetFrameSize(const std::string& buffer, size_t pos) {
+    uint32_t size = 0;
+    for (int i = 0; i < 4; ++i) {
+        size |= static_cast<uint32_t>(static_cast<uint8_t>(buffer[pos + i])) << (8 * i);
+    }
+    return size;
+}
+}  // namespace
+
+EvalServer::EvalServer(const std::string& path, std::function<void(Interpreter*)> init,
+                       const EvalServerOptions& options)
+    : path_{path}, init_{std::move(init)}, options_{options} {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw RuntimeError("Socket path is too long: " + path);
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    // Only a socket left by an earlier server is replaced; any other file is the user's.
+    struct stat existing;
+    if (lstat(path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            throw RuntimeError("Can't listen on " + path + ": not a socket");
+        }
+        unlink(path.c_str());
+    }
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (listen_fd_ < 0 || epoll_fd_ < 0 || wake_fd_ < 0 ||
+        bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listen_fd_, SOMAXCONN) < 0) {
+        auto error = std::string(std::strerror(errno));
+        for (int fd : {listen_fd_, epoll_fd_, wake_fd_}) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        throw RuntimeError("Can't listen on " + path + ": " + error);
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listen_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+    event.data.fd = wake_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+
+    for (size_t i = 0; i < options_.spare_interpreters; ++i) {
+        spare_.push_back(NewInterpreter());
+    }
+}
+
+EvalServer::~EvalServer() {
+    GetScheduler().HelpUntil([this] { return tasks_ == 0; });
+    for (auto& [fd, session] : sessions_) {
+        close(fd);
+    }
+    close(listen_fd_);
+    close(epoll_fd_);
+    close(wake_fd_);
+    unlink(path_.c_str());
+}
+
+void EvalServer::Serve() {
+    epoll_event events[kMaxEvents];
+    while (!stop_) {
+        int count = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw RuntimeError("epoll_wait failed");
+        }
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd_) {
+                Accept();
+            } else if (fd == wake_fd_) {
+                uint64_t value;
+                while (read(wake_fd_, &value, sizeof(value)) > 0) {
+                }
+            } else if (auto it = sessions_.find(fd); it != sessions_.end()) {
+                auto session = it->second;
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    Read(session);
+                }
+                if (sessions_.count(fd) && (events[i].events & EPOLLOUT)) {
+                    Flush(session);
+                }
+            }
+        }
+
+        std::vector<std::shared_ptr<Session>> ready;
+        {
+            std::lock_guard lock(ready_mutex_);
+            ready.swap(ready_);
+        }
+        for (const auto& session : ready) {
+            if (sessions_.count(session->fd) && sessions_[session->fd] == session) {
+                Flush(session);
+            }
+        }
+        bool refill = false;
+        {
+            std::lock_guard lock(spare_mutex_);
+            if (!refilling_ && spare_.size() < options_.spare_interpreters) {
+                refilling_ = refill = true;
+            }
+        }
+        if (refill) {
+            ++tasks_;
+            GetScheduler().Spawn([this] { Refill(); });
+        }
+    }
+}
+
+void EvalServer::Stop() {
+    stop_ = true;
+    Wake();
+}
+
+void EvalServer::Accept() {
+    while (true) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        auto session = std::make_shared<Session>();
+        session->fd = fd;
+        {
+            std::lock_guard lock(spare_mutex_);
+            if (!spare_.empty()) {
+                session->interpreter = std::move(spare_.back());
+                spare_.pop_back();
+            }
+        }
+        if (!session->interpreter) {
+            session->interpreter = NewInterpreter();
+        }
+        Watch(session.get());
+        sessions_.emplace(fd, std::move(session));
+    }
+}
+
+void EvalServer::Read(const std::shared_ptr<Session>& session) {
+    {
+        // A hangup is reported even while the input isn't watched.
+        std::lock_guard lock(session->mutex);
+        if (IsFull(*session)) {
+            return;
+        }
+    }
+    char buffer[kReadChunk];
+    bool eof = false;
+    while (true) {
+        auto received = read(session->fd, buffer, sizeof(buffer));
+        if (received > 0) {
+            session->input.append(buffer, received);
+            continue;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        eof = received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+        break;
+    }
+
+    std::vector<std::string> requests;
+    size_t pos = 0;
+    while (session->input.size() - pos >= 4) {
+        auto size = GetFrameSize(session->input, pos);
+        if (size > kMaxFrame) {
+            Close(session);
+            return;
+        }
+        if (session->input.size() - pos - 4 < size) {
+            break;
+        }
+        requests.push_back(session->input.substr(pos + 4, size));
+        pos += 4 + size;
+    }
+    session->input.erase(0, pos);
+
+    if (!requests.empty()) {
+        bool start = false;
+        {
+            std::lock_guard lock(session->mutex);
+            for (auto& request : requests) {
+                session->requests.push_back(std::move(request));
+            }
+            start = !session->running;
+            session->running = true;
+            Watch(session.get());
+        }
+        if (start) {
+            ++tasks_;
+            GetScheduler().Spawn([this, session] { Evaluate(session); });
+        }
+    }
+    if (eof) {
+        {
+            std::lock_guard lock(session->mutex);
+            session->closing = true;
+            Watch(session.get());
+        }
+        CloseIfDone(session);
+    }
+}
+
+void EvalServer::Flush(const std::shared_ptr<Session>& session) {
+    bool failed = false;
+    {
+        std::lock_guard lock(session->mutex);
+        size_t pos = 0;
+        while (pos < session->output.size()) {
+            auto written = send(session->fd, session->output.data() + pos,
+                                session->output.size() - pos, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                failed = errno != EAGAIN && errno != EWOULDBLOCK;
+                break;
+            }
+            pos += written;
+        }
+        session->output.erase(0, pos);
+        Watch(session.get());
+    }
+    if (failed) {
+        Close(session);
+    } else {
+        CloseIfDone(session);
+    }
+}
+
+void EvalServer::Close(const std::shared_ptr<Session>& session) {
+    // A running evaluation keeps the session alive until it is done; its replies are dropped.
+    if (session->watched) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, session->fd, nullptr);
+    }
+    sessions_.erase(session->fd);
+    std::lock_guard lock(session->mutex);
+    close(session->fd);
+    session->fd = -1;
+    session->requests.clear();
+}
+
+void EvalServer::CloseIfDone(const std::shared_ptr<Session>& session) {
+    {
+        std::lock_guard lock(session->mutex);
+        if (!session->closing || session->running || !session->output.empty()) {
+            return;
+        }
+    }
+    Close(session);
+}
+
+bool EvalServer::IsFull(const Session& session) const {
+    return session.requests.size() >= options_.max_queued_requests ||
+           session.output.size() >= options_.max_output_bytes;
+}
+
+void EvalServer::Watch(Session* session) {
+    // Level-triggered: a closed input or an empty output must not be watched, or it would be
+    // reported over and over. The input of a full session waits until a reply goes out, which
+    // watches the session again.
+    bool reading = !session->closing && !IsFull(*session);
+    uint32_t events = (reading ? static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP) : 0u) |
+                      (session->output.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = session->fd;
+    if (events == 0) {
+        if (session->watched) {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, session->fd, nullptr);
+            session->watched = false;
+        }
+    } else {
+        epoll_ctl(epoll_fd_, session->watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, session->fd,
+                  &event);
+        session->watched = true;
+    }
+}
+
+void EvalServer::Evaluate(std::shared_ptr<Session> session) {
+    std::string request;
+    {
+        std::lock_guard lock(session->mutex);
+        if (session->requests.empty()) {
+            // The session was closed before the evaluation started.
+            session->running = false;
+            --tasks_;
+            return;
+        }
+        request = std::move(session->requests.front());
+        session->requests.pop_front();
+    }
+    while (true) {
+        std::string reply;
+        try {
+            AppendFrame(0, session->interpreter->Run(request, options_.budget), &reply);
+        } catch (const std::exception& e) {
+            AppendFrame(1, e.what(), &reply);
+        }
+        bool done = false;
+        {
+            // The last reply and the end of the evaluation are published together, so the flush
+            // that sends it also sees whether a closing session can be closed.
+            std::lock_guard lock(session->mutex);
+            session->output += reply;
+            if (session->requests.empty()) {
+                session->running = false;
+                done = true;
+            } else {
+                request = std::move(session->requests.front());
+                session->requests.pop_front();
+            }
+        }
+        {
+            std::lock_guard lock(ready_mutex_);
+            ready_.push_back(session);
+        }
+        Wake();
+        if (done) {
+            break;
+        }
+    }
+    --tasks_;
+}
+
+void EvalServer::Wake() {
+    uint64_t one = 1;
+    while (write(wake_fd_, &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+}
+
+void EvalServer::Refill() {
+    while (true) {
+        {
+            std::lock_guard lock(spare_mutex_);
+            if (spare_.size() >= options_.spare_interpreters) {
+                refilling_ = false;
+                break;
+            }
+        }
+        std::unique_ptr<Interpreter> interpreter;
+        try {
+            interpreter = NewInterpreter();
+        } catch (const std::exception&) {
+            // Accept builds the interpreter itself then and reports the error.
+            std::lock_guard lock(spare_mutex_);
+            refilling_ = false;
+            break;
+        }
+        std::lock_guard lock(spare_mutex_);
+        spare_.push_back(std::move(interpreter));
+    }
+    --tasks_;
+}
+
+std::unique_ptr<Interpreter> EvalServer::NewInterpreter() {
+    auto interpreter = std::make_unique<Interpreter>();
+    if (init_) {
+        init_(interpreter.get());
+    }
+    // Set after init, which may load an image larger than what a client may allocate.
+    interpreter->SetMemoryLimit(options_.memory_limit);
+    return interpreter;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "budget.h"
+#include "scheme.h"
+
+// Evaluation server on a Unix domain socket. Every connection is a session with an interpreter
+// of its own, so definitions persist between the requests of one client and never leak to
+// another. A request is a frame holding one expression; the reply is a frame holding a status
+// byte (0 for success, 1 for an error) followed by the printed result or the error message. A
+// frame is a 4-byte little-endian length and that many bytes. Clients may pipeline requests;
+// the replies of a session come in request order.
+//
+// One thread multiplexes the connections with epoll and the evaluations run on the scheduler's
+// workers, at most one at a time per session.
+struct EvalServerOptions {
+    // Interpreters kept ready so that accepting a client doesn't wait for one.
+    size_t spare_interpreters{4};
+    // Every request runs under it, futures and parallel maps it starts included, so a client
+    // can't keep a worker busy forever or overflow a native stack; a request that runs out of
+    // it gets an error reply.
+    Budget budget{0, std::chrono::seconds(10), 5000};
+    // Heap limit of every session's interpreter, see Interpreter::SetMemoryLimit.
+    size_t memory_limit{256 << 20};
+    // The server stops reading from a client while this many of its requests wait for
+    // evaluation or this many bytes of its replies wait to be sent.
+    size_t max_queued_requests{64};
+    size_t max_output_bytes{16 << 20};
+};
+
+class EvalServer {
+public:
+    // init prepares every fresh interpreter, e.g. loads a prelude.
+    EvalServer(const std::string& path, std::function<void(Interpreter*)> init = {},
+               const EvalServerOptions& options = EvalServerOptions{});
+
+    // Waits for the evaluations that are still running.
+    ~EvalServer();
+
+    EvalServer(const EvalServer&) = delete;
+
+    EvalServer& operator=(const EvalServer&) = delete;
+
+    // Serves clients until Stop is called.
+    void Serve();
+
+    // May be called from any thread.
+    void Stop();
+
+private:
+    struct Session {
+        int fd;
+        std::unique_ptr<Interpreter> interpreter;
+        // Bytes read but not yet forming a whole frame; used by the serving thread only.
+        std::string input;
+        std::mutex mutex;
+        std::deque<std::string> requests;
+        std::string output;
+        bool running{false};
+        // Set once the client has stopped sending; the session ends when its replies are out.
+        bool closing{false};
+        bool watched{false};
+    };
+
+    void Accept();
+
+    void Read(const std::shared_ptr<Session>& session);
+
+    void Flush(const std::shared_ptr<Session>& session);
+
+    void Close(const std::shared_ptr<Session>& session);
+
+    // Closes the session if the client is done and every reply has been sent.
+    void CloseIfDone(const std::shared_ptr<Session>& session);
+
+    // Whether the session has as much work queued as it may; called with its mutex held.
+    bool IsFull(const Session& session) const;
+
+    // Registers for the events the session currently waits for; called with its mutex held
+    // once the session is shared with the workers.
+    void Watch(Session* session);
+
+    // Evaluates the queued requests of the session on a scheduler worker.
+    void Evaluate(std::shared_ptr<Session> session);
+
+    void Wake();
+
+    // Builds interpreters on a scheduler worker until there are enough spare ones, so that the
+    // serving thread never waits for init.
+    void Refill();
+
+    std::unique_ptr<Interpreter> NewInterpreter();
+
+    std::string path_;
+    std::function<void(Interpreter*)> init_;
+    EvalServerOptions options_;
+    std::mutex spare_mutex_;
+    std::vector<std::unique_ptr<Interpreter>> spare_;
+    bool refilling_{false};
+    int listen_fd_{-1};
+    int epoll_fd_{-1};
+    int wake_fd_{-1};
+    std::atomic<bool> stop_{false};
+    std::unordered_map<int, std::shared_ptr<Session>> sessions_;
+    std::mutex ready_mutex_;
+    std::vector<std::shared_ptr<Session>> ready_;
+    // Evaluations and refills running on the scheduler.
+    std::atomic<size_t> tasks_{0};
+};
@@ -1,4 +1,5 @@
 #include "functions.h"
+#include "budget.h"
 #include <cstddef>
 #include <vector>
 #include "error.h"
@@ -6,6 +7,19 @@
 #include "scheme.h"
 #include "scope.h"
 #include "garbage_collector.h"
+#include "hash_table.h"
+#include "heap_dump.h"
+#include "perf_counters.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "tracer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
 
 Function* GetVariable(Object* ptr, Scope* scope) {
     if (Is<Number>(ptr)) {
@@ -22,8 +36,10 @@ Function* GetVariable(Object* ptr, Scope* scope) {
         if (As<Symbol>(ptr)->GetName() == "lambda") {
             return GetGC().New<Variable>(GetGC().New<LambdaGenerator>(scope));
         }
-    } else if (Is<Bool>(ptr)) {
+    } else if (Is<Bool>(ptr) || Is<Vector>(ptr)) {
         return GetGC().New<Variable>(ptr);
+    } else if (Is<Variable>(ptr)) {
+        return As<Variable>(ptr);
     }
     if (scope->par_scope_ == nullptr) {
         throw NameError("There is no variable with such name");
@@ -32,11 +48,35 @@ Function* GetVariable(Object* ptr, Scope* scope) {
     }
 }
 
+bool IsBuiltin(Object* obj) {
+    return Is<Function>(obj) && !Is<Variable>(obj) && !Is<Lambda>(obj) &&
+           !Is<LambdaGenerator>(obj);
+}
+
+Object* Apply(Function* function, const std::vector<Object*>& args, Scope* scope) {
+    // The call form is (function arg...), every argument wrapped in a Variable evaluating to it.
+    Cell* form(GetGC().New<Cell>());
+    form->GetFirst() = function;
+    Cell* last = form;
+    for (auto arg : args) {
+        Cell* next_cell(GetGC().New<Cell>());
+        next_cell->GetFirst() = GetGC().New<Variable>(arg);
+        last->GetSecond() = next_cell;
+        last = next_cell;
+    }
+    if (counted_builtins) {
+        return InvokeCounted(function, form, scope);
+    }
+    CallFrame frame(function);
+    return function->Invoke(form, scope);
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// general
 template <class T>
 std::vector<Object*> CalcVector(const std::vector<Object*>& input, Scope* scope) {
     std::vector<Object*> ans;
+    LocalRoots roots(&ans);
     for (size_t i = 1; i < input.size(); ++i) {
         ans.push_back(CalcExpression(input[i], scope));
         if (!Is<T>(ans.back())) {
@@ -419,6 +459,245 @@ Object* ListTailFunction::Invoke(Object* ptr, Scope* scope) {
     }
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Vectors
+
+// Checks that index is a number within [0, size).
+size_t GetIndex(Object* index, size_t size, const char* function) {
+    if (!Is<Number>(index)) {
+        throw RuntimeError(std::string(function) + " function's index should be a number");
+    }
+    auto value = As<Number>(index)->GetValue();
+    if (value < 0 || static_cast<uint64_t>(value) >= size) {
+        throw RuntimeError(std::string(function) + " function's index is out of range");
+    }
+    return value;
+}
+
+Object* IsVectorFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("Is vector function should have 1 parameter");
+    }
+    return GetGC().New<Bool>(Is<Vector>(CalcExpression(input[1], scope)));
+}
+
+Object* VectorFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    std::vector<Object*> elements;
+    LocalRoots roots(&elements);
+    for (size_t i = 1; i < input.size(); ++i) {
+        elements.push_back(CalcExpression(input[i], scope));
+    }
+    return GetGC().New<Vector>(std::move(elements));
+}
+
+Object* MakeVectorFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2 && input.size() != 3) {
+        throw RuntimeError("Make-vector function should have 1 or 2 parameters");
+    }
+    auto size = CalcExpression(input[1], scope);
+    if (!Is<Number>(size) || As<Number>(size)->GetValue() < 0) {
+        throw RuntimeError("Make-vector function's size should be a non-negative number");
+    }
+    auto fill = input.size() == 3 ? CalcExpression(input[2], scope) : nullptr;
+    return NewVector(static_cast<uint64_t>(As<Number>(size)->GetValue()), fill);
+}
+
+Object* VectorLengthFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("Vector-length function should have 1 parameter");
+    }
+    auto vector = CalcExpression(input[1], scope);
+    if (!Is<Vector>(vector)) {
+        throw RuntimeError("Vector-length function's parameter should be a vector");
+    }
+    return GetGC().New<Number>(As<Vector>(vector)->GetElements().size());
+}
+
+Object* VectorRefFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 3) {
+        throw RuntimeError("Vector-ref function should have 2 parameters");
+    }
+    auto vector = CalcExpression(input[1], scope);
+    if (!Is<Vector>(vector)) {
+        throw RuntimeError("Vector-ref function's first parameter should be a vector");
+    }
+    auto& elements = As<Vector>(vector)->GetElements();
+    return elements[GetIndex(CalcExpression(input[2], scope), elements.size(), "Vector-ref")];
+}
+
+Object* VectorSetFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 4) {
+        throw RuntimeError("Vector-set function should have 3 parameters");
+    }
+    auto vector = CalcExpression(input[1], scope);
+    if (!Is<Vector>(vector)) {
+        throw RuntimeError("Vector-set function's first parameter should be a vector");
+    }
+    if (SharedEnvironment::IsShared(vector)) {
+        throw RuntimeError("Vector-set function can't change a vector of a shared environment");
+    }
+    auto& elements = As<Vector>(vector)->GetElements();
+    auto index = GetIndex(CalcExpression(input[2], scope), elements.size(), "Vector-set");
+    auto val = CalcExpression(input[3], scope);
+    elements[index] = val;
+    return val;
+}
+
+Object* VectorToListFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("Vector->list function should have 1 parameter");
+    }
+    auto vector = CalcExpression(input[1], scope);
+    if (!Is<Vector>(vector)) {
+        throw RuntimeError("Vector->list function's parameter should be a vector");
+    }
+    Object* ans = nullptr;
+    const auto& elements = As<Vector>(vector)->GetElements();
+    for (auto it = elements.rbegin(); it != elements.rend(); ++it) {
+        Cell* cell(GetGC().New<Cell>());
+        cell->GetFirst() = *it;
+        cell->GetSecond() = ans;
+        ans = cell;
+    }
+    return ans;
+}
+
+Object* ListToVectorFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("List->vector function should have 1 parameter");
+    }
+    auto list = CalcExpression(input[1], scope);
+    size_t count = 0;
+    auto rest = list;
+    for (; Is<Cell>(rest); rest = As<Cell>(rest)->GetSecond()) {
+        ++count;
+    }
+    if (rest) {
+        throw RuntimeError("List->vector function's parameter should be a list");
+    }
+    auto vector = NewVector(count);
+    for (auto& el : vector->GetElements()) {
+        el = As<Cell>(list)->GetFirst();
+        list = As<Cell>(list)->GetSecond();
+    }
+    return vector;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Hash tables
+
+HashTable* GetHashTable(Object* obj, const char* function) {
+    if (!Is<HashTable>(obj)) {
+        throw RuntimeError(std::string(function) +
+                           " function's first parameter should be a hash table");
+    }
+    return As<HashTable>(obj);
+}
+
+Object* IsHashTableFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("Is hash table function should have 1 parameter");
+    }
+    return GetGC().New<Bool>(Is<HashTable>(CalcExpression(input[1], scope)));
+}
+
+Object* MakeHashTableFunction::Invoke(Object* ptr, Scope*) {
+    if (Convert(ptr).size() != 1) {
+        throw RuntimeError("Make-hash-table function should have no parameters");
+    }
+    return GetGC().New<HashTable>();
+}
+
+Object* HashTableRefFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 3 && input.size() != 4) {
+        throw RuntimeError("Hash-table-ref function should have 2 or 3 parameters");
+    }
+    auto table = GetHashTable(CalcExpression(input[1], scope), "Hash-table-ref");
+    auto key = CalcExpression(input[2], scope);
+    if (auto value = table->Find(key)) {
+        return *value;
+    }
+    if (input.size() == 4) {
+        return CalcExpression(input[3], scope);
+    }
+    throw RuntimeError("Hash-table-ref function's key is not in the table");
+}
+
+Object* HashTableSetFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 4) {
+        throw RuntimeError("Hash-table-set function should have 3 parameters");
+    }
+    auto table = GetHashTable(CalcExpression(input[1], scope), "Hash-table-set");
+    if (SharedEnvironment::IsShared(table)) {
+        throw RuntimeError("Hash-table-set function can't change a table of a shared environment");
+    }
+    auto key = CalcExpression(input[2], scope);
+    auto val = CalcExpression(input[3], scope);
+    table->Set(key, val);
+    return val;
+}
+
+Object* HashTableDeleteFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 3) {
+        throw RuntimeError("Hash-table-delete function should have 2 parameters");
+    }
+    auto table = GetHashTable(CalcExpression(input[1], scope), "Hash-table-delete");
+    if (SharedEnvironment::IsShared(table)) {
+        throw RuntimeError(
+            "Hash-table-delete function can't change a table of a shared environment");
+    }
+    return GetGC().New<Bool>(table->Erase(CalcExpression(input[2], scope)));
+}
+
+Object* HashTableContainsFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 3) {
+        throw RuntimeError("Hash-table-contains function should have 2 parameters");
+    }
+    auto table = GetHashTable(CalcExpression(input[1], scope), "Hash-table-contains");
+    return GetGC().New<Bool>(table->Find(CalcExpression(input[2], scope)) != nullptr);
+}
+
+Object* HashTableCountFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("Hash-table-count function should have 1 parameter");
+    }
+    auto table = GetHashTable(CalcExpression(input[1], scope), "Hash-table-count");
+    return GetGC().New<Number>(table->Size());
+}
+
+Object* HashTableToAlistFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("Hash-table->alist function should have 1 parameter");
+    }
+    auto table = GetHashTable(CalcExpression(input[1], scope), "Hash-table->alist");
+    Object* ans = nullptr;
+    table->ForEach([&](Object* key, Object* value) {
+        Cell* pair(GetGC().New<Cell>());
+        pair->GetFirst() = key;
+        pair->GetSecond() = value;
+        Cell* cell(GetGC().New<Cell>());
+        cell->GetFirst() = pair;
+        cell->GetSecond() = ans;
+        ans = cell;
+    });
+    return ans;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
 /// If
 
@@ -479,6 +758,7 @@ Object* DefineLambda(Object* ptr, Scope* scope) {
     lambda_actions.erase(lambda_actions.begin(), lambda_actions.begin() + 2);
 
     auto rhs = GetGC().New<Lambda>(scope, lambda_capture_params, lambda_actions);
+    rhs->name_ = name;
     scope->Set(As<Symbol>(name)->GetName(), rhs);
     return rhs;
 }
@@ -500,6 +780,11 @@ Object* DefineFunction::Invoke(Object* ptr, Scope* scope) {
         throw RuntimeError("Define should have a string as a first parameter");
     }
     if (Is<Lambda>(rhs)) {
+        // A lambda of a SharedEnvironment, whose scope is frozen, may be bound by interpreters on
+        // other threads at the same time, so it stays anonymous.
+        if (!As<Lambda>(rhs)->name_ && !As<Lambda>(rhs)->par_scope_->frozen_) {
+            As<Lambda>(rhs)->name_ = lhs;
+        }
         scope->Set(As<Symbol>(lhs)->GetName(), rhs);
     } else {
         scope->Set(As<Symbol>(lhs)->GetName(), GetGC().New<Variable>(rhs));
@@ -511,8 +796,14 @@ Object* DefineFunction::Invoke(Object* ptr, Scope* scope) {
 /// Set
 
 void TrySet(Object* name, Object* val, Scope* scope) {
-    bool is_set = scope->TrySet(As<Symbol>(name)->GetName(), val);
-    if (is_set) {
+    const auto& var = As<Symbol>(name)->GetName();
+    if (scope->frozen_) {
+        // Every interpreter over the environment, and the closures defined in it, read the
+        // binding, so a private copy couldn't be seen by all of them.
+        if (scope->Get(var)) {
+            throw RuntimeError("Set function can't change a binding of a shared environment");
+        }
+    } else if (scope->TrySet(var, val)) {
         return;
     }
     if (scope->par_scope_ == nullptr) {
@@ -562,6 +853,9 @@ Object* SetCarFunction::Invoke(Object* ptr, Scope* scope) {
     if (!Is<Cell>(name)) {
         throw RuntimeError("Set-car function should have pair or list as the first parameter");
     }
+    if (SharedEnvironment::IsShared(name)) {
+        throw RuntimeError("Set-car function can't change a pair of a shared environment");
+    }
     auto val = CalcExpression(input[2], scope);
     As<Cell>(name)->GetFirst() = val;
     return val;
@@ -590,6 +884,9 @@ Object* SetCdrFunction::Invoke(Object* ptr, Scope* scope) {
     if (!Is<Cell>(name)) {
         throw RuntimeError("Set-cdr function should have symbol as the first parameter");
     }
+    if (SharedEnvironment::IsShared(name)) {
+        throw RuntimeError("Set-cdr function can't change a pair of a shared environment");
+    }
     auto val = CalcExpression(input[2], scope);
     As<Cell>(name)->GetSecond() = val;
     return val;
@@ -616,6 +913,8 @@ Lambda::Lambda(Scope* scope, const std::vector<Object*>& params,
 }
 
 Object* Lambda::Invoke(Object* ptr, Scope* scope) {
+    CallDepthGuard depth;
+    LambdaSpan span(name_);
     auto input = Convert(ptr);
     if (input.size() != 1 + params_.size()) {
         throw RuntimeError("Lambda's parameter pack and call pack lengths differ");
@@ -674,4 +973,398 @@ Object* LambdaGenerator::Invoke(Object* ptr, Scope*) {
     auto params = GetParams(input[1]);
     auto actions = GetActions(input);
     return GetGC().New<Lambda>(scope_, params, actions);
-}
\ No newline at end of file
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Parallel
+
+constexpr size_t kChunksPerWorker = 4;
+
+std::vector<Object*> ParallelApply(Function* function, const std::vector<Object*>& items,
+                                   Scope* scope) {
+    std::vector<Object*> results(items.size());
+    auto& scheduler = GetScheduler();
+    size_t chunks = std::min(items.size(), (scheduler.Size() + 1) * kChunksPerWorker);
+    if (chunks <= 1 || scheduler.Size() == 0) {
+        // A green thread applying the function may be preempted in between.
+        LocalRoots item_roots(&items);
+        LocalRoots result_roots(&results);
+        for (size_t i = 0; i < items.size(); ++i) {
+            results[i] = Apply(function, {items[i]}, scope);
+        }
+        return results;
+    }
+
+    std::vector<GarbageCollector> regions(chunks);
+    for (auto& region : regions) {
+        region.MakeRegionOf(GetGC());
+    }
+    std::vector<std::exception_ptr> errors(chunks);
+    std::atomic<size_t> done{0};
+    auto budget = BudgetGuard::Inherited();
+    GetGC().BeginConcurrentEvaluation();
+    for (size_t c = 0; c < chunks; ++c) {
+        scheduler.Spawn([&, c] {
+            ActiveGC guard(&regions[c]);
+            ActiveGreenScheduler no_green_threads(nullptr);
+            BudgetGuard limits(budget);
+            try {
+                for (size_t i = c * items.size() / chunks; i < (c + 1) * items.size() / chunks;
+                     ++i) {
+                    results[i] = Apply(function, {items[i]}, scope);
+                }
+            } catch (...) {
+                errors[c] = std::current_exception();
+            }
+            ++done;
+        });
+    }
+    scheduler.HelpUntil([&] { return done == chunks; });
+    GetGC().EndConcurrentEvaluation();
+
+    for (auto& region : regions) {
+        GetGC().Adopt(&region);
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return results;
+}
+
+std::vector<Object*> GetParallelArgs(Object* ptr, Scope* scope, Function** function) {
+    auto input = Convert(ptr);
+    if (input.size() != 3) {
+        throw RuntimeError("Parallel map function should have 2 parameters");
+    }
+    // Evaluated one by one since the list may be empty, which CalcVector rejects.
+    std::vector<Object*> params{CalcExpression(input[1], scope), CalcExpression(input[2], scope)};
+    if (!Is<Function>(params[0])) {
+        throw RuntimeError("Parallel map function should have a function as the first parameter");
+    }
+    std::vector<Object*> items;
+    auto list = params[1];
+    while (Is<Cell>(list)) {
+        items.push_back(As<Cell>(list)->GetFirst());
+        list = As<Cell>(list)->GetSecond();
+    }
+    if (list != nullptr) {
+        throw RuntimeError("Parallel map function should have a list as the second parameter");
+    }
+    *function = As<Function>(params[0]);
+    return items;
+}
+
+Object* ParallelMapFunction::Invoke(Object* ptr, Scope* scope) {
+    Function* function;
+    auto items = GetParallelArgs(ptr, scope, &function);
+    auto results = ParallelApply(function, items, scope);
+    Object* ans = nullptr;
+    for (size_t i = results.size(); i > 0; --i) {
+        Cell* cell(GetGC().New<Cell>());
+        cell->GetFirst() = results[i - 1];
+        cell->GetSecond() = ans;
+        ans = cell;
+    }
+    return ans;
+}
+
+Object* ParallelForEachFunction::Invoke(Object* ptr, Scope* scope) {
+    Function* function;
+    auto items = GetParallelArgs(ptr, scope, &function);
+    ParallelApply(function, items, scope);
+    return nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Futures
+
+Future::Future(Object* expr, Scope* scope) : expr_{expr}, scope_{scope} {
+    region_.MakeRegionOf(GetGC());
+}
+
+void Future::Start() {
+    region_.BeginConcurrentEvaluation();
+    GetScheduler().Spawn([this, budget = BudgetGuard::Inherited()] {
+        {
+            ActiveGC guard(&region_);
+            ActiveGreenScheduler no_green_threads(nullptr);
+            BudgetGuard limits(budget);
+            try {
+                result_ = CalcExpression(expr_, scope_);
+            } catch (...) {
+                error_ = std::current_exception();
+            }
+        }
+        region_.EndConcurrentEvaluation();
+        done_ = true;
+    });
+}
+
+bool Future::IsDone() const {
+    return done_;
+}
+
+void Future::Wait() {
+    GetScheduler().HelpUntil([this] { return IsDone(); });
+}
+
+Object* Future::Touch() {
+    Wait();
+    GetGC().Adopt(&region_);
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+    return result_;
+}
+
+Object* FutureFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw SyntaxError("Future should have 1 parameter");
+    }
+    auto future = GetGC().New<Future>(input[1], scope);
+    GetGC().AddFuture(future);
+    future->Start();
+    return future;
+}
+
+Object* TouchFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("Touch function should have 1 parameter");
+    }
+    auto future = CalcExpression(input[1], scope);
+    if (!Is<Future>(future)) {
+        throw RuntimeError("Touch function's parameter should be a future");
+    }
+    return As<Future>(future)->Touch();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Green threads
+
+GreenScheduler* GetGreenSchedulerOrThrow() {
+    auto scheduler = GetGreenScheduler();
+    if (!scheduler) {
+        throw RuntimeError("Green threads can be used only on the interpreter's own thread");
+    }
+    return scheduler;
+}
+
+// Either a green thread channel or one shared with other interpreters.
+Object* GetChannel(Object* ptr, Scope* scope) {
+    auto channel = CalcExpression(ptr, scope);
+    if (!Is<Channel>(channel) && !Is<SharedChannel>(channel)) {
+        throw RuntimeError("Channel function's first parameter should be a channel");
+    }
+    return channel;
+}
+
+Object* SpawnFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("Spawn function should have 1 parameter");
+    }
+    auto body = CalcExpression(input[1], scope);
+    if (!Is<Function>(body)) {
+        throw RuntimeError("Spawn function's parameter should be a function");
+    }
+    auto scheduler = GetGreenSchedulerOrThrow();
+    auto thread = GetGC().New<GreenThread>(As<Function>(body), scope);
+    scheduler->Spawn(thread);
+    return thread;
+}
+
+Object* YieldFunction::Invoke(Object* ptr, Scope*) {
+    if (Convert(ptr).size() != 1) {
+        throw RuntimeError("Yield function should have no parameters");
+    }
+    GetGreenSchedulerOrThrow()->Yield();
+    return nullptr;
+}
+
+Object* MakeChannelFunction::Invoke(Object* ptr, Scope*) {
+    if (Convert(ptr).size() != 1) {
+        throw RuntimeError("Make-channel function should have no parameters");
+    }
+    return GetGC().New<Channel>();
+}
+
+Object* ChannelSendFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 3) {
+        throw RuntimeError("Channel-send function should have 2 parameters");
+    }
+    auto channel = GetChannel(input[1], scope);
+    auto value = CalcExpression(input[2], scope);
+    if (Is<Channel>(channel)) {
+        As<Channel>(channel)->Send(value);
+    } else {
+        As<SharedChannel>(channel)->Send(value);
+    }
+    return nullptr;
+}
+
+Object* ChannelReceiveFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("Channel-recv function should have 1 parameter");
+    }
+    auto channel = GetChannel(input[1], scope);
+    if (Is<Channel>(channel)) {
+        return As<Channel>(channel)->Receive();
+    }
+    return As<SharedChannel>(channel)->Receive();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Profiling
+
+Object* ProfileFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("Profile should have 1 parameter");
+    }
+    SamplingProfiler profiler;
+    profiler.AddNames(scope);
+    Object* result;
+    {
+        ActiveProfiler sampling(&profiler);
+        result = CalcExpression(input[1], scope);
+    }
+    std::cerr << profiler.GetFoldedStacks() << std::flush;
+    return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Telemetry
+
+Cell* MakePair(Object* first, Object* second) {
+    Cell* cell(GetGC().New<Cell>());
+    cell->GetFirst() = first;
+    cell->GetSecond() = second;
+    return cell;
+}
+
+Object* MakeList(const std::vector<Object*>& items) {
+    Object* ans = nullptr;
+    for (size_t i = items.size(); i > 0; --i) {
+        ans = MakePair(items[i - 1], ans);
+    }
+    return ans;
+}
+
+Object* MakeEntry(const std::string& name, int64_t value) {
+    return MakePair(GetGC().New<Symbol>(name), GetGC().New<Number>(value));
+}
+
+Object* GcStatsFunction::Invoke(Object* ptr, Scope*) {
+    if (Convert(ptr).size() != 1) {
+        throw RuntimeError("Gc-stats should have no parameters");
+    }
+    auto stats = GetGC().GetStats();
+    auto objects = GetGC().CountObjects();
+    auto micros = [](std::chrono::nanoseconds time) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+    };
+    std::vector<Object*> by_type;
+    for (const auto& [type, count] : objects) {
+        by_type.push_back(MakeEntry(type, count));
+    }
+    return MakeList({
+        MakeEntry("heap-bytes", stats.bytes),
+        MakeEntry("peak-heap-bytes", stats.peak_bytes),
+        MakeEntry("allocations", stats.allocations),
+        MakeEntry("bytes-allocated", stats.bytes_allocated),
+        MakeEntry("collections", stats.collections),
+        MakeEntry("mark-time", micros(stats.mark_time.GetSum())),
+        MakeEntry("sweep-time", micros(stats.sweep_time.GetSum())),
+        MakePair(GetGC().New<Symbol>("objects"), MakeList(by_type)),
+    });
+}
+
+Object* BuiltinStatsFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() > 2) {
+        throw RuntimeError("Builtin-stats should have at most 1 parameter");
+    }
+    auto stats = GetBuiltinStats();
+    if (!stats) {
+        throw RuntimeError("Builtin calls are only counted by an interpreter");
+    }
+    if (input.size() == 2) {
+        auto on = CalcExpression(input[1], scope);
+        if (!Is<Bool>(on)) {
+            throw RuntimeError("Bad input");
+        }
+        auto was_on = stats->IsEnabled();
+        stats->SetEnabled(As<Bool>(on)->GetValue());
+        return GetGC().New<Bool>(was_on);
+    }
+    auto micros = [](std::chrono::nanoseconds time) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+    };
+    std::vector<Object*> entries;
+    for (const auto& counters : stats->GetCounters()) {
+        entries.push_back(MakeList({
+            GetGC().New<Symbol>(counters.name),
+            MakeEntry("calls", counters.calls),
+            MakeEntry("arguments", counters.arguments),
+            MakeEntry("allocations", counters.allocations),
+            MakeEntry("time", micros(counters.time)),
+            MakeEntry("self-time", micros(counters.self_time)),
+        }));
+    }
+    return MakeList(entries);
+}
+
+Object* WithPerfCountersFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("With-perf-counters should have 1 parameter");
+    }
+    PerfCounters counters;
+    counters.Start();
+    auto value = CalcExpression(input[1], scope);
+    auto report = counters.Stop();
+    auto micros = [](std::chrono::nanoseconds time) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+    };
+    std::vector<Object*> entries = {
+        MakePair(GetGC().New<Symbol>("value"), value),
+        MakeEntry("wall-time", micros(report.wall_time)),
+        MakeEntry("cpu-time", micros(report.cpu_time)),
+    };
+    const std::pair<const char*, const std::optional<uint64_t>&> hardware[] = {
+        {"cycles", report.cycles},
+        {"instructions", report.instructions},
+        {"cache-misses", report.cache_misses},
+        {"branch-misses", report.branch_misses}};
+    for (const auto& [name, count] : hardware) {
+        if (count) {
+            entries.push_back(MakeEntry(name, *count));
+        }
+    }
+    return MakeList(entries);
+}
+
+Object* DumpHeapFunction::Invoke(Object* ptr, Scope* scope) {
+    auto input = Convert(ptr);
+    if (input.size() != 2) {
+        throw RuntimeError("Dump-heap should have 1 parameter");
+    }
+    auto path = CalcExpression(input[1], scope);
+    if (!Is<Symbol>(path)) {
+        throw RuntimeError("Bad input");
+    }
+    // The global scope of the interpreter is the outermost one not frozen by a SharedEnvironment.
+    // Inside a future or a parallel map the active collector is a region, which doesn't hold it.
+    auto root = scope;
+    while (root->par_scope_ && !root->par_scope_->frozen_) {
+        root = root->par_scope_;
+    }
+    auto count = WriteHeapDumpFile(root, As<Symbol>(path)->GetName());
+    return GetGC().New<Number>(count);
+}
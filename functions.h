@@ -1,12 +1,17 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
+#include <exception>
 #include <vector>
 #include "garbage_collector.h"
+#include "green_threads.h"
+#include "message_channel.h"
 #include "object.h"
 #include "scheme.h"
 #include "tokenizer.h"
 #include "scope.h"
+#include "shared_environment.h"
 
 class Function : public Object {
 public:
@@ -16,8 +21,14 @@ public:
 };
 
 Function* GetVariable(Object* ptr, Scope* scope);
+
+// Whether obj is one of the functions bound by RegisterBuiltins.
+bool IsBuiltin(Object* obj);
 Function* GenerateFunction(Object* ptr, Scope* scope);
 
+// Calls function with already evaluated arguments.
+Object* Apply(Function* function, const std::vector<Object*>& args, Scope* scope);
+
 // Numbers
 class IsNumberFunction : public Function {
 public:
@@ -211,6 +222,127 @@ public:
     Object* Invoke(Object* ptr, Scope* scope) override;
 };
 
+// Vectors
+class IsVectorFunction : public Function {
+public:
+    ~IsVectorFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class VectorFunction : public Function {
+public:
+    ~VectorFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// (make-vector k fill) is a vector of k elements, all fill; fill defaults to the empty list.
+class MakeVectorFunction : public Function {
+public:
+    ~MakeVectorFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class VectorLengthFunction : public Function {
+public:
+    ~VectorLengthFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class VectorRefFunction : public Function {
+public:
+    ~VectorRefFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class VectorSetFunction : public Function {
+public:
+    ~VectorSetFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class VectorToListFunction : public Function {
+public:
+    ~VectorToListFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class ListToVectorFunction : public Function {
+public:
+    ~ListToVectorFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// Hash tables
+class IsHashTableFunction : public Function {
+public:
+    ~IsHashTableFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// (make-hash-table) is an empty table. Numbers and booleans are the same key if their values are
+// equal and symbols if their names are, anything else only if it is the same object.
+class MakeHashTableFunction : public Function {
+public:
+    ~MakeHashTableFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// (hash-table-ref table key default) is the value of key; default is evaluated only if key is
+// absent, and without it an absent key is an error.
+class HashTableRefFunction : public Function {
+public:
+    ~HashTableRefFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class HashTableSetFunction : public Function {
+public:
+    ~HashTableSetFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// (hash-table-delete! table key) is whether key was present.
+class HashTableDeleteFunction : public Function {
+public:
+    ~HashTableDeleteFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class HashTableContainsFunction : public Function {
+public:
+    ~HashTableContainsFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class HashTableCountFunction : public Function {
+public:
+    ~HashTableCountFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// (hash-table->alist table) is a list of (key . value) pairs in no particular order.
+class HashTableToAlistFunction : public Function {
+public:
+    ~HashTableToAlistFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
 // IF
 class IfFunction : public Function {
 public:
@@ -280,6 +412,8 @@ public:
     Scope* par_scope_;
     std::vector<Object*> params_;
     std::vector<Object*> actions_;
+    // Symbol of the define that first bound the lambda, nullptr while it is anonymous.
+    Object* name_{nullptr};
 };
 
 class LambdaGenerator : public Function {
@@ -291,4 +425,148 @@ public:
     Object* Invoke(Object* ptr, Scope* scope) override;
 
     Scope* scope_;
-};
\ No newline at end of file
+};
+
+// Parallel
+// Apply a function to every element of a list on the scheduler's workers. The function must not
+// mutate shared state; every chunk of the list allocates into its own heap, which is merged into
+// the caller's afterwards.
+class ParallelMapFunction : public Function {
+public:
+    ~ParallelMapFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class ParallelForEachFunction : public Function {
+public:
+    ~ParallelForEachFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// Futures
+// Value of an expression evaluated on a scheduler worker. The evaluation allocates into the
+// future's own heap, which joins the heap of whoever touches the future first.
+class Future : public Object {
+public:
+    Future(Object* expr, Scope* scope);
+
+    ~Future() override = default;
+
+    void Start();
+
+    bool IsDone() const;
+
+    // Blocks until the evaluation has finished, running other scheduler tasks meanwhile.
+    void Wait();
+
+    // Waits for the value and rethrows the error of the evaluation, if any.
+    Object* Touch();
+
+    Object* expr_;
+    Scope* scope_;
+    Object* result_{nullptr};
+    GarbageCollector region_;
+
+private:
+    std::exception_ptr error_;
+    std::atomic<bool> done_{false};
+};
+
+class FutureFunction : public Function {
+public:
+    ~FutureFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class TouchFunction : public Function {
+public:
+    ~TouchFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// Green threads
+class SpawnFunction : public Function {
+public:
+    ~SpawnFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class YieldFunction : public Function {
+public:
+    ~YieldFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class MakeChannelFunction : public Function {
+public:
+    ~MakeChannelFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class ChannelSendFunction : public Function {
+public:
+    ~ChannelSendFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+class ChannelReceiveFunction : public Function {
+public:
+    ~ChannelReceiveFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// Profiling
+// Evaluates the expression under a SamplingProfiler and writes its folded stacks to stderr.
+class ProfileFunction : public Function {
+public:
+    ~ProfileFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// (with-perf-counters expr) evaluates expr and returns ((value . result) (wall-time . us)
+// (cpu-time . us) (cycles . n)...), leaving out the hardware counters that are unavailable.
+class WithPerfCountersFunction : public Function {
+public:
+    ~WithPerfCountersFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// (dump-heap path) writes everything reachable from the global scope to path as a heap dump (see
+// heap_dump.h) and returns the number of objects written. The path is a symbol, e.g.
+// '/tmp/heap, as the language has no strings. Only defined by Interpreter::BindDumpHeap.
+class DumpHeapFunction : public Function {
+public:
+    ~DumpHeapFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// Association list of the counters of the current heap, times in microseconds, ending with an
+// (objects (type . count)...) entry. Garbage of the current evaluation is counted too.
+class GcStatsFunction : public Function {
+public:
+    ~GcStatsFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
+
+// (builtin-stats) is a list of (name (calls . n) (arguments . n) (allocations . n) (time . us)
+// (self-time . us)) entries, one per builtin called while counting was on, most self time
+// first. (builtin-stats on) switches counting on or off and returns whether it was on.
+class BuiltinStatsFunction : public Function {
+public:
+    ~BuiltinStatsFunction() override = default;
+
+    Object* Invoke(Object* ptr, Scope* scope) override;
+};
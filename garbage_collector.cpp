@@ -1,84 +1,430 @@
 #include "garbage_collector.h"
 #include "error.h"
 #include "functions.h"
+#include "hash_table.h"
+#include "heap_references.h"
 #include "object.h"
+#include "tracer.h"
+#include <cxxabi.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <typeindex>
+#include <typeinfo>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
-void Dfs(Object* v, std::unordered_set<Object*>& used) {
-    used.insert(v);
-    if (!v) {
-        return;
-    }
-    if (Is<Cell>(v)) {
-        auto ptr = As<Cell>(v);
-        if (!used.count(ptr->GetFirst())) {
-            Dfs(ptr->GetFirst(), used);
-        }
-        if (!used.count(ptr->GetSecond())) {
-            Dfs(ptr->GetSecond(), used);
-        }
-    } else if (Is<Variable>(v)) {
-        auto ptr = As<Variable>(v);
-        if (!used.count(ptr->var_)) {
-            Dfs(ptr->var_, used);
-        }
-    }  else if (Is<Variable>(v)) {
-        auto ptr = As<Variable>(v);
-        if (!used.count(ptr->var_)) {
-            Dfs(ptr->var_, used);
-        }
-    } else if (Is<LambdaGenerator>(v)) {
-        auto ptr = As<LambdaGenerator>(v);
-        if (!used.count(ptr->scope_)) {
-            Dfs(ptr->scope_, used);
-        }
-    } else if (Is<Lambda>(v)) {
-        auto ptr = As<Lambda>(v);
-        if (!used.count(ptr->par_scope_)) {
-            Dfs(ptr->par_scope_, used);
-        }
-        for (auto el : ptr->params_) {
-            if (!used.count(el)) {
-                Dfs(el, used);
-            }
-        }
-        for (auto el : ptr->actions_) {
-            if (!used.count(el)) {
-                Dfs(el, used);
-            }
-        }
-    } else if (Is<Scope>(v)) {
-        auto ptr = As<Scope>(v);
-        if (!used.count(ptr->par_scope_)) {
-            Dfs(ptr->par_scope_, used);
+namespace {
+// Marks everything reachable from root. The stack is explicit, as long lists and deep scope
+// chains would overflow the native one.
+void Mark(Object* root, std::unordered_set<Object*>& used) {
+    std::vector<Object*> stack{root};
+    used.insert(root);
+    while (!stack.empty()) {
+        auto v = stack.back();
+        stack.pop_back();
+        if (!v) {
+            continue;
         }
-        for (const auto& el : ptr->mp_) {
-            if (!used.count(el.second)) {
-                Dfs(el.second, used);
+        ForEachReference(v, [&](Object* obj, std::string_view) {
+            if (used.insert(obj).second) {
+                stack.push_back(obj);
             }
+        });
+    }
+}
+
+// Objects the words point into. Objects are allocated one by one, so a word can only point into
+// the closest object starting at or below it, and only if it is within the largest object type.
+std::vector<Object*> FindReferencedObjects(const std::vector<std::unique_ptr<Object>>& memory,
+                                           const std::vector<uintptr_t>& words) {
+    constexpr size_t kMaxObjectSize =
+        std::max({sizeof(Cell), sizeof(Vector), sizeof(HashTable), sizeof(Scope), sizeof(Lambda),
+                  sizeof(Future), sizeof(GreenThread), sizeof(Channel)});
+    std::vector<uintptr_t> starts;
+    starts.reserve(memory.size());
+    for (const auto& obj : memory) {
+        starts.push_back(reinterpret_cast<uintptr_t>(obj.get()));
+    }
+    std::sort(starts.begin(), starts.end());
+    std::vector<Object*> objects;
+    for (auto word : words) {
+        auto it = std::upper_bound(starts.begin(), starts.end(), word);
+        if (it != starts.begin() && word - *std::prev(it) < kMaxObjectSize) {
+            objects.push_back(reinterpret_cast<Object*>(*std::prev(it)));
         }
+    }
+    return objects;
+}
+
+size_t StringBytes(const std::string& s) {
+    static const size_t inline_capacity = std::string().capacity();
+    return s.capacity() > inline_capacity ? s.capacity() + 1 : 0;
+}
+
+template <class T>
+size_t QueueBytes(const std::deque<T>& queue) {
+    return queue.size() * sizeof(T);
+}
+}  // namespace
+
+size_t OwnedBytes(const Symbol* symbol) {
+    return StringBytes(symbol->GetName());
+}
+
+size_t OwnedBytes(const Lambda* lambda) {
+    return (lambda->params_.capacity() + lambda->actions_.capacity()) * sizeof(Object*);
+}
+
+size_t OwnedBytes(const Vector* vector) {
+    return vector->GetElements().capacity() * sizeof(Object*);
+}
+
+size_t OwnedBytes(const HashTable* table) {
+    return table->GetStorageBytes();
+}
+
+Vector* NewVector(size_t count, Object* fill) {
+    if (count > std::vector<Object*>().max_size()) {
+        throw ResourceExhausted("Vector is too long");
+    }
+    auto vector = GetGC().New<Vector>(std::vector<Object*>());
+    GetGC().Charge(count * sizeof(Object*));
+    try {
+        vector->GetElements().assign(count, fill);
+    } catch (const std::bad_alloc&) {
+        throw ResourceExhausted("Vector is too long");
+    }
+    return vector;
+}
+
+size_t BindingBytes(const std::string& name) {
+    // A node of the map: the key-value pair, the link to the next node and the cached hash.
+    return sizeof(std::pair<const std::string, Object*>) + sizeof(void*) + sizeof(size_t) +
+           StringBytes(name);
+}
+
+size_t Footprint(const Object* obj) {
+    auto v = const_cast<Object*>(obj);
+    size_t bytes = sizeof(std::unique_ptr<Object>);
+    if (Is<Cell>(v)) {
+        bytes += sizeof(Cell);
     } else if (Is<Number>(v)) {
+        bytes += sizeof(Number);
     } else if (Is<Bool>(v)) {
+        bytes += sizeof(Bool);
     } else if (Is<Symbol>(v)) {
+        bytes += sizeof(Symbol) + OwnedBytes(As<Symbol>(v));
+    } else if (Is<Vector>(v)) {
+        bytes += sizeof(Vector) + OwnedBytes(As<Vector>(v));
+    } else if (Is<HashTable>(v)) {
+        bytes += sizeof(HashTable) + OwnedBytes(As<HashTable>(v));
+    } else if (Is<Variable>(v)) {
+        bytes += sizeof(Variable);
+    } else if (Is<Scope>(v)) {
+        auto scope = As<Scope>(v);
+        bytes += sizeof(Scope) + scope->mp_.bucket_count() * sizeof(void*);
+        for (const auto& el : scope->mp_) {
+            bytes += BindingBytes(el.first);
+        }
+    } else if (Is<Lambda>(v)) {
+        bytes += sizeof(Lambda) + OwnedBytes(As<Lambda>(v));
+    } else if (Is<LambdaGenerator>(v)) {
+        bytes += sizeof(LambdaGenerator);
+    } else if (Is<Future>(v)) {
+        bytes += sizeof(Future);
+    } else if (Is<GreenThread>(v)) {
+        bytes += sizeof(GreenThread);
+    } else if (Is<Channel>(v)) {
+        auto channel = As<Channel>(v);
+        bytes += sizeof(Channel) + QueueBytes(channel->values_) + QueueBytes(channel->waiters_);
+    } else if (Is<SharedChannel>(v)) {
+        bytes += sizeof(SharedChannel);
+    } else {
+        // Builtins carry nothing but their vtable.
+        bytes += sizeof(Function);
+    }
+    return bytes;
+}
+
+namespace {
+const std::string& GetTypeName(std::type_index type) {
+    // Every thread looks up the few types it has seen in a cache of its own; only the first
+    // lookup of a type on a thread takes the lock. Names are never erased, so the cached
+    // references stay valid.
+    thread_local std::unordered_map<std::type_index, const std::string*> cache;
+    if (auto it = cache.find(type); it != cache.end()) {
+        return *it->second;
     }
+    static std::mutex mutex;
+    static std::unordered_map<std::type_index, std::string> names;
+    std::lock_guard lock(mutex);
+    auto [it, inserted] = names.emplace(type, "");
+    if (inserted) {
+        int status;
+        auto demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+        it->second = status == 0 ? demangled : type.name();
+        std::free(demangled);
+    }
+    cache.emplace(type, &it->second);
+    return it->second;
+}
+}  // namespace
+
+const std::string& GetTypeName(const Object* obj) {
+    return GetTypeName(typeid(*obj));
+}
+
+GarbageCollector::~GarbageCollector() {
+    Release(bytes_);
 }
 
-void GarbageCollector::CleanUp() {
+void GarbageCollector::CleanUp(const ExternalRoots& roots) {
+    if (HasRunningFutures()) {
+        return;
+    }
+    auto bytes_before = bytes_;
+    auto start = std::chrono::steady_clock::now();
     std::unordered_set<Object*> used;
-    Dfs(memory_.front().get(), used);
+    Mark(memory_.front().get(), used);
+    for (auto obj : roots.objects) {
+        Mark(obj, used);
+    }
+    if (!roots.words.empty()) {
+        for (auto obj : FindReferencedObjects(memory_, roots.words)) {
+            Mark(obj, used);
+        }
+    }
+    auto marked = std::chrono::steady_clock::now();
+    mark_time_.Record(marked - start);
+    if (auto tracer = Tracer::GetActive()) {
+        tracer->Add("gc", "Mark", start, marked);
+    }
+    if (allocation_profiler_) {
+        allocation_profiler_->OnCollection(used);
+    }
+    // Results of dying futures that were never touched may still be referenced from elsewhere
+    // (a future touched by another one), so their heaps are kept until the next collection.
+    GarbageCollector orphans;
+    for (size_t i = 0; i < futures_.size(); ++i) {
+        while (futures_.size() > i && !used.count(futures_[i])) {
+            orphans.Adopt(&futures_[i]->region_);
+            std::swap(futures_[i], futures_.back());
+            futures_.pop_back();
+        }
+    }
+    bytes_ = 0;
     for (size_t i = 0; i < memory_.size(); ++i) {
         while (memory_.size() > i && !used.count(memory_[i].get())) {
+            if (!locations_.empty()) {
+                locations_.erase(memory_[i].get());
+            }
             std::swap(memory_[i], memory_.back());
             memory_.pop_back();
         }
+        if (i < memory_.size()) {
+            bytes_ += Footprint(memory_[i].get());
+        }
+    }
+    if (limit_) {
+        // The recount may exceed the running total, which doesn't include every hash bucket.
+        limit_->bytes -= bytes_before;
+        limit_->bytes += bytes_;
     }
+    Adopt(&orphans);
+    auto swept = std::chrono::steady_clock::now();
+    sweep_time_.Record(swept - marked);
+    if (auto tracer = Tracer::GetActive()) {
+        tracer->Add("gc", "Sweep", marked, swept);
+    }
+    ++collections_;
 }
 
 void GarbageCollector::ClearAll() {
+    WaitForFutures();
+    if (allocation_profiler_) {
+        allocation_profiler_->OnCollection({});
+    }
+    futures_.clear();
     memory_.clear();
+    Release(std::exchange(bytes_, 0));
+    locations_.clear();
+}
+
+void GarbageCollector::SetRoot(Object* root) {
+    for (auto& obj : memory_) {
+        if (obj.get() == root) {
+            std::swap(obj, memory_.front());
+            return;
+        }
+    }
+    throw RuntimeError("Root must be owned by the garbage collector");
+}
+
+void GarbageCollector::Adopt(GarbageCollector* other) {
+    memory_.reserve(memory_.size() + other->memory_.size());
+    for (auto& obj : other->memory_) {
+        memory_.push_back(std::move(obj));
+    }
+    other->memory_.clear();
+    locations_.merge(other->locations_);
+    other->locations_.clear();
+    futures_.insert(futures_.end(), other->futures_.begin(), other->futures_.end());
+    other->futures_.clear();
+    auto bytes = std::exchange(other->bytes_, 0);
+    if (other->limit_ != limit_) {
+        other->Release(bytes);
+        if (limit_) {
+            limit_->bytes += bytes;
+        }
+    }
+    bytes_ += bytes;
+    peak_bytes_ = std::max(peak_bytes_, bytes_);
+    allocations_ += std::exchange(other->allocations_, 0);
+    bytes_allocated_ += std::exchange(other->bytes_allocated_, 0);
+}
+
+size_t GarbageCollector::GetBytes() const {
+    return bytes_;
+}
+
+HeapStats GarbageCollector::GetStats() const {
+    return {bytes_,       peak_bytes_, allocations_, bytes_allocated_,
+            collections_, mark_time_,  sweep_time_};
+}
+
+size_t GarbageCollector::GetAllocationCount() const {
+    return allocations_;
+}
+
+std::map<std::string, size_t> GarbageCollector::CountObjects() const {
+    // Names are resolved once per type rather than once per object.
+    std::unordered_map<std::type_index, size_t> by_type;
+    for (const auto& obj : memory_) {
+        ++by_type[typeid(*obj)];
+    }
+    std::map<std::string, size_t> counts;
+    for (const auto& [type, count] : by_type) {
+        counts[GetTypeName(type)] += count;
+    }
+    return counts;
+}
+
+void GarbageCollector::ResetPeak() {
+    peak_bytes_ = bytes_;
+}
+
+void GarbageCollector::SetLimit(size_t bytes) {
+    Release(bytes_);
+    limit_ = bytes ? std::make_shared<HeapLimit>(bytes, bytes_) : nullptr;
+}
+
+void GarbageCollector::MakeRegionOf(const GarbageCollector& parent) {
+    Release(bytes_);
+    limit_ = parent.limit_;
+    if (limit_) {
+        limit_->bytes += bytes_;
+    }
+    concurrent_evaluations_ = parent.concurrent_evaluations_;
+}
+
+size_t GarbageCollector::GetLimit() const {
+    return limit_ ? limit_->limit : 0;
+}
+
+void GarbageCollector::BeginConcurrentEvaluation() {
+    concurrent_evaluations_->fetch_add(1, std::memory_order_acq_rel);
+}
+
+void GarbageCollector::EndConcurrentEvaluation() {
+    concurrent_evaluations_->fetch_sub(1, std::memory_order_acq_rel);
+}
+
+bool GarbageCollector::IsEvaluatedConcurrently() const {
+    return concurrent_evaluations_->load(std::memory_order_acquire) > 0;
+}
+
+void GarbageCollector::SetAllocationProfiler(AllocationProfiler* profiler) {
+    allocation_profiler_ = profiler;
+}
+
+void GarbageCollector::OnLimitExceeded() {
+    throw ResourceExhausted("Heap limit of " + std::to_string(limit_->limit) +
+                            " bytes exceeded");
+}
+
+void GarbageCollector::Release(size_t bytes) {
+    if (limit_) {
+        limit_->bytes -= bytes;
+    }
+}
+
+void GarbageCollector::AddFuture(Future* future) {
+    futures_.push_back(future);
+}
+
+bool GarbageCollector::HasRunningFutures() const {
+    for (auto future : futures_) {
+        // The region of a finished future is no longer written by its thread.
+        if (!future->IsDone() || future->region_.HasRunningFutures()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void GarbageCollector::WaitForFutures() {
+    for (auto future : futures_) {
+        future->Wait();
+        future->region_.WaitForFutures();
+    }
+}
+
+void GarbageCollector::SetLocation(const Object* obj, SourceLocation location) {
+    locations_[obj] = location;
+}
+
+const SourceLocation* GarbageCollector::GetLocation(const Object* obj) const {
+    auto it = locations_.find(obj);
+    return it == locations_.end() ? nullptr : &it->second;
+}
+
+namespace {
+thread_local GarbageCollector* active_gc = nullptr;
+thread_local LocalRoots* local_roots = nullptr;
+}  // namespace
+
+LocalRoots::LocalRoots(const std::vector<Object*>* values)
+    : values_{values}, parent_{local_roots} {
+    local_roots = this;
+}
+
+LocalRoots::~LocalRoots() {
+    local_roots = parent_;
+}
+
+LocalRoots* ExchangeLocalRoots(LocalRoots* roots) {
+    return std::exchange(local_roots, roots);
+}
+
+ActiveGC::ActiveGC(GarbageCollector* gc) : prev_{active_gc} {
+    active_gc = gc;
+}
+
+ActiveGC::~ActiveGC() {
+    active_gc = prev_;
 }
 
 GarbageCollector& GetGC() {
+    if (active_gc) {
+        return *active_gc;
+    }
     static GarbageCollector gc;
     return gc;
 }
\ No newline at end of file
@@ -1,26 +1,243 @@
 #pragma once
 
 #include "object.h"
+#include "profiler.h"
+#include "source_location.h"
+#include "telemetry.h"
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
 #include <utility>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 
+class Future;
+class HashTable;
+class Lambda;
+
+// Bytes an object owns besides itself, for the heap accounting. Only types whose storage is
+// fixed at construction are charged this way; scopes charge their bindings as they are added.
+inline size_t OwnedBytes(const Object*) {
+    return 0;
+}
+
+size_t OwnedBytes(const Symbol* symbol);
+
+size_t OwnedBytes(const Lambda* lambda);
+
+size_t OwnedBytes(const Vector* vector);
+
+size_t OwnedBytes(const HashTable* table);
+
+// Allocates a vector of count elements set to fill in the current garbage collector. The
+// storage is charged before it is allocated, so a vector over the heap limit fails without
+// taking the memory first. Throws ResourceExhausted for a count that can't be allocated.
+Vector* NewVector(size_t count, Object* fill = nullptr);
+
+// Heap storage of one binding of a scope.
+size_t BindingBytes(const std::string& name);
+
+// Exact number of bytes obj and the storage it owns take.
+size_t Footprint(const Object* obj);
+
+// Name of the dynamic type of obj, e.g. "Cell".
+const std::string& GetTypeName(const Object* obj);
+
+// References to the heap from outside it, which CleanUp marks from besides its root: those of
+// suspended green threads.
+struct ExternalRoots {
+    std::vector<Object*> objects;
+    // Words of native stacks and saved registers, scanned conservatively: a word that points into
+    // an object of the heap keeps the object alive, any other is ignored.
+    std::vector<uintptr_t> words;
+};
+
+// Values an evaluation holds off the heap while it evaluates further expressions, such as the
+// arguments evaluated so far. A green thread may be suspended meanwhile, and the collector marks
+// the values of suspended threads. Roots link up to the innermost one of the current thread.
+class LocalRoots {
+public:
+    explicit LocalRoots(const std::vector<Object*>* values);
+
+    ~LocalRoots();
+
+    LocalRoots(const LocalRoots&) = delete;
+
+    LocalRoots& operator=(const LocalRoots&) = delete;
+
+    const std::vector<Object*>* values_;
+    LocalRoots* parent_;
+};
+
+// Replaces the innermost local roots of the current thread. Green threads keep roots of their
+// own, which are swapped in whenever they are switched to.
+LocalRoots* ExchangeLocalRoots(LocalRoots* roots);
+
+struct HeapStats {
+    size_t bytes;
+    // Highest value bytes reached since the collector was created or ResetPeak was called.
+    size_t peak_bytes;
+    // Objects allocated over the collector's lifetime, including those already collected.
+    size_t allocations;
+    // Bytes charged over the collector's lifetime.
+    size_t bytes_allocated;
+    // CleanUp calls that collected; those put off by running futures are not counted.
+    size_t collections;
+    LatencyHistogram mark_time;
+    LatencyHistogram sweep_time;
+};
+
+// Cap on the bytes of a heap together with the regions of its futures and parallel maps, which
+// charge it from their own threads.
+struct HeapLimit {
+    HeapLimit(size_t limit, size_t bytes) : limit{limit}, bytes{bytes} {
+    }
+
+    const size_t limit;
+    std::atomic<size_t> bytes;
+};
+
 class GarbageCollector {
 public:
     GarbageCollector() = default;
 
+    ~GarbageCollector();
+
+    GarbageCollector(GarbageCollector&&) = default;
+
     template <class T, class... Args>
     T* New(Args&&... args) {
+        constexpr size_t bytes = sizeof(T) + sizeof(std::unique_ptr<Object>);
+        Charge(bytes);
+        ++allocations_;
         memory_.emplace_back(std::make_unique<T>(std::forward<Args>(args)...));
-        return As<T>(memory_.back().get());
+        auto obj = As<T>(memory_.back().get());
+        auto owned = OwnedBytes(obj);
+        Charge(owned);
+        if (allocation_profiler_) {
+            allocation_profiler_->OnAllocation(obj, bytes + owned);
+        }
+        return obj;
     }
 
-    void CleanUp();
+    // Accounts for bytes allocated on behalf of the heap. Throws ResourceExhausted instead if
+    // that would exceed the limit; collection can't run in the middle of an evaluation, so the
+    // evaluation fails and its garbage is collected when it has unwound.
+    void Charge(size_t bytes) {
+        bytes_ += bytes;
+        bytes_allocated_ += bytes;
+        if (bytes_ > peak_bytes_) {
+            peak_bytes_ = bytes_;
+        }
+        if (limit_ && limit_->bytes.fetch_add(bytes) + bytes > limit_->limit) {
+            OnLimitExceeded();
+        }
+    }
+
+    // Bytes taken by the objects of this heap: exact after CleanUp, an upper bound in between.
+    size_t GetBytes() const;
+
+    HeapStats GetStats() const;
+
+    // GetStats().allocations, without copying the histograms.
+    size_t GetAllocationCount() const;
+
+    // Objects of the heap by type name. Exact after CleanUp; in between, garbage is counted too.
+    std::map<std::string, size_t> CountObjects() const;
+
+    // Restarts tracking the peak from the current size.
+    void ResetPeak();
+
+    // 0 disables the limit. Regions sharing the previous limit keep charging it.
+    void SetLimit(size_t bytes);
+
+    // Makes this heap a region of parent: it is charged against the limit of parent, so that all
+    // the regions of an evaluation stay within it together, and counts concurrent evaluations
+    // with parent.
+    void MakeRegionOf(const GarbageCollector& parent);
+
+    size_t GetLimit() const;
+
+    // While evaluation runs on other threads (futures, parallel maps), the scopes of this heap may
+    // be read and written concurrently. Scope operations then go through a striped lock table;
+    // otherwise they cost a single atomic load. Begin must be called by the thread starting the
+    // concurrent work before it starts, End once the work has finished.
+    void BeginConcurrentEvaluation();
+
+    void EndConcurrentEvaluation();
+
+    // Whether this heap, its regions or the heap they are regions of evaluate concurrently.
+    bool IsEvaluatedConcurrently() const;
+
+    // Reports the allocations and collections of this heap to profiler; nullptr detaches it.
+    // Heaps of futures and parallel maps are not reported.
+    void SetAllocationProfiler(AllocationProfiler* profiler);
+
+    void CleanUp(const ExternalRoots& roots = {});
 
     void ClearAll();
 
+    // Makes root the object CleanUp starts marking from.
+    void SetRoot(Object* root);
+
+    // Moves every object owned by other into this collector, leaving other empty.
+    void Adopt(GarbageCollector* other);
+
+    // Source positions of parsed list heads, kept off the objects so Cell stays two pointers.
+    // Entries are dropped together with the objects they describe.
+    void SetLocation(const Object* obj, SourceLocation location);
+
+    const SourceLocation* GetLocation(const Object* obj) const;
+
+    // Futures allocated here. While any of them is still running, CleanUp does nothing: the
+    // running evaluation reads objects that only its native stack refers to.
+    void AddFuture(Future* future);
+
+    // Whether a future allocated here, or a future created by one of them, is still running. A
+    // future that has finished may have started others that haven't, and its region, which
+    // lists them, may be adopted by this collector at any time.
+    bool HasRunningFutures() const;
+
+    // Blocks until every future allocated here, and every future they created, has finished.
+    void WaitForFutures();
+
     std::vector<std::unique_ptr<Object>> memory_;
+
+private:
+    [[noreturn]] void OnLimitExceeded();
+
+    // Takes bytes this heap no longer holds off its limit.
+    void Release(size_t bytes);
+
+    std::unordered_map<const Object*, SourceLocation> locations_;
+    std::vector<Future*> futures_;
+    size_t bytes_{0};
+    size_t peak_bytes_{0};
+    size_t allocations_{0};
+    size_t bytes_allocated_{0};
+    size_t collections_{0};
+    LatencyHistogram mark_time_;
+    LatencyHistogram sweep_time_;
+    std::shared_ptr<HeapLimit> limit_;
+    std::shared_ptr<std::atomic<size_t>> concurrent_evaluations_{
+        std::make_shared<std::atomic<size_t>>(0)};
+    AllocationProfiler* allocation_profiler_{nullptr};
+};
+
+// While alive, makes GetGC() on the current thread allocate into gc instead of the default
+// collector. Used to give worker threads their own allocation region.
+class ActiveGC {
+public:
+    ActiveGC(GarbageCollector* gc);
+
+    ~ActiveGC();
+
+private:
+    GarbageCollector* prev_;
 };
 
 GarbageCollector& GetGC();
\ No newline at end of file
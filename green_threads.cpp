@@ -0,0 +1,264 @@
+#include "green_threads.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "budget.h"
+#include "error.h"
+#include "functions.h"
+#include "profiler.h"
+
+namespace {
+// Pages are committed on first touch, so an idle thread costs the few pages it has used.
+constexpr size_t kStackSize = 1 << 20;
+// Nested lambda calls on a green thread, whatever the budget allows: deep recursion fails with
+// ResourceExhausted instead of running into the guard page. A call of a simple recursive lambda
+// takes about 1 KiB of stack in unoptimized builds and 1.5 KiB with an address sanitizer, which
+// leaves room for calls nesting larger expressions.
+constexpr size_t kMaxDepth = 256;
+constexpr size_t kMaxFreeStacks = 64;
+
+thread_local GreenScheduler* active_scheduler = nullptr;
+
+// Thrown into a cancelled thread; deliberately not a std::exception.
+struct Cancellation {};
+
+size_t GuardSize() {
+    static const size_t page = sysconf(_SC_PAGESIZE);
+    return page;
+}
+
+void* AllocateStack() {
+    void* base = mmap(nullptr, kStackSize + GuardSize(), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        throw RuntimeError("Can't allocate a green thread stack");
+    }
+    // Overflowing the stack faults on the guard page instead of overwriting the neighbour.
+    mprotect(base, GuardSize(), PROT_NONE);
+    return base;
+}
+
+void FreeStack(void* stack) {
+    munmap(stack, kStackSize + GuardSize());
+}
+
+// Stacks hold redzones an address sanitizer would report reads of.
+__attribute__((no_sanitize("address"))) void AddWords(const void* begin, const void* end,
+                                                      std::vector<uintptr_t>* words) {
+    auto first = reinterpret_cast<uintptr_t>(begin) & ~(alignof(uintptr_t) - 1);
+    for (auto word = reinterpret_cast<const uintptr_t*>(first); word + 1 <= end; ++word) {
+        words->push_back(*word);
+    }
+}
+}  // namespace
+
+GreenThread::GreenThread(Function* body, Scope* scope) : body_{body}, scope_{scope} {
+}
+
+GreenThread::~GreenThread() {
+    if (stack_) {
+        FreeStack(stack_);
+    }
+}
+
+bool GreenThread::IsDone() const {
+    return done_;
+}
+
+namespace {
+GreenScheduler* GetChannelScheduler() {
+    auto scheduler = GetGreenScheduler();
+    if (!scheduler) {
+        throw RuntimeError("Channels can be used only on the interpreter's own thread");
+    }
+    return scheduler;
+}
+}  // namespace
+
+void Channel::Send(Object* value) {
+    auto scheduler = GetChannelScheduler();
+    values_.push_back(value);
+    if (!waiters_.empty()) {
+        auto waiter = waiters_.front();
+        waiters_.pop_front();
+        scheduler->Wake(waiter);
+    }
+}
+
+Object* Channel::Receive() {
+    auto scheduler = GetChannelScheduler();
+    while (values_.empty()) {
+        if (scheduler->Current()) {
+            waiters_.push_back(scheduler->Current());
+            scheduler->Block();
+        } else if (!scheduler->RunOne()) {
+            throw RuntimeError("Receiving from an empty channel would block forever");
+        }
+    }
+    auto value = values_.front();
+    values_.pop_front();
+    return value;
+}
+
+GreenScheduler::~GreenScheduler() {
+    for (auto stack : free_stacks_) {
+        FreeStack(stack);
+    }
+}
+
+void GreenScheduler::Spawn(GreenThread* thread) {
+    if (free_stacks_.empty()) {
+        thread->stack_ = AllocateStack();
+    } else {
+        thread->stack_ = free_stacks_.back();
+        free_stacks_.pop_back();
+    }
+    getcontext(&thread->context_);
+    thread->context_.uc_stack.ss_sp = static_cast<char*>(thread->stack_) + GuardSize();
+    thread->context_.uc_stack.ss_size = kStackSize;
+    thread->context_.uc_link = &main_context_;
+    makecontext(&thread->context_, &GreenScheduler::Start, 0);
+    threads_.push_back(thread);
+    ready_.push_back(thread);
+}
+
+void GreenScheduler::Yield() {
+    if (current_) {
+        ready_.push_back(current_);
+        Suspend();
+    } else {
+        for (size_t count = ready_.size(); count > 0 && RunOne(); --count) {
+        }
+    }
+}
+
+void GreenScheduler::Block() {
+    if (!current_) {
+        throw RuntimeError("Only a green thread can block");
+    }
+    Suspend();
+}
+
+void GreenScheduler::Wake(GreenThread* thread) {
+    ready_.push_back(thread);
+}
+
+void GreenScheduler::RunReady() {
+    while (RunOne()) {
+    }
+}
+
+bool GreenScheduler::RunOne() {
+    if (ready_.empty()) {
+        return false;
+    }
+    auto thread = ready_.front();
+    ready_.pop_front();
+    current_ = thread;
+    auto depth = ExchangeCallDepth(thread->depth_);
+    auto frame = ExchangeCallFrame(thread->frame_);
+    auto counted = ExchangeCountedCall(thread->counted_);
+    auto roots = ExchangeLocalRoots(thread->roots_);
+    {
+        CallDepthLimit limit(kMaxDepth);
+        swapcontext(&main_context_, &thread->context_);
+    }
+    thread->roots_ = ExchangeLocalRoots(roots);
+    thread->counted_ = ExchangeCountedCall(counted);
+    thread->frame_ = ExchangeCallFrame(frame);
+    thread->depth_ = ExchangeCallDepth(depth);
+    current_ = nullptr;
+    if (thread->done_) {
+        threads_.erase(std::find(threads_.begin(), threads_.end(), thread));
+        if (free_stacks_.size() < kMaxFreeStacks) {
+            free_stacks_.push_back(thread->stack_);
+        } else {
+            FreeStack(thread->stack_);
+        }
+        thread->stack_ = nullptr;
+        if (thread->error_) {
+            std::rethrow_exception(std::exchange(thread->error_, nullptr));
+        }
+    }
+    return true;
+}
+
+bool GreenScheduler::HasReady() const {
+    return !ready_.empty();
+}
+
+void GreenScheduler::Cancel() {
+    ready_.clear();
+    for (auto thread : std::vector<GreenThread*>(threads_)) {
+        // A thread that never ran has nothing on its stack.
+        if (!thread->stack_pointer_) {
+            continue;
+        }
+        thread->cancelled_ = true;
+        ready_.push_back(thread);
+        try {
+            RunOne();
+        } catch (const Cancellation&) {
+        }
+    }
+}
+
+GreenThread* GreenScheduler::Current() const {
+    return current_;
+}
+
+ExternalRoots GreenScheduler::GetRoots() const {
+    ExternalRoots roots;
+    for (auto thread : threads_) {
+        roots.objects.push_back(thread);
+        for (auto local = thread->roots_; local; local = local->parent_) {
+            roots.objects.insert(roots.objects.end(), local->values_->begin(),
+                                 local->values_->end());
+        }
+        if (thread->stack_pointer_) {
+            auto top = static_cast<char*>(thread->stack_) + GuardSize() + kStackSize;
+            AddWords(thread->stack_pointer_, top, &roots.words);
+            const auto& registers = thread->context_.uc_mcontext;
+            AddWords(&registers, &registers + 1, &roots.words);
+        }
+    }
+    return roots;
+}
+
+void GreenScheduler::Start() {
+    // Exceptions can't cross stacks, so they are handed over to the driving thread.
+    auto thread = active_scheduler->current_;
+    try {
+        thread->result_ = Apply(thread->body_, {}, thread->scope_);
+    } catch (...) {
+        thread->error_ = std::current_exception();
+    }
+    thread->done_ = true;
+}
+
+void GreenScheduler::Suspend() {
+    // The frames of the thread lie above this one; swapcontext saves the registers in the
+    // machine context of context_.
+    char marker;
+    current_->stack_pointer_ = &marker;
+    swapcontext(&current_->context_, &main_context_);
+    if (current_->cancelled_) {
+        throw Cancellation{};
+    }
+}
+
+ActiveGreenScheduler::ActiveGreenScheduler(GreenScheduler* scheduler) : prev_{active_scheduler} {
+    active_scheduler = scheduler;
+}
+
+ActiveGreenScheduler::~ActiveGreenScheduler() {
+    active_scheduler = prev_;
+}
+
+GreenScheduler* GetGreenScheduler() {
+    return active_scheduler;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <ucontext.h>
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <vector>
+
+#include "garbage_collector.h"
+#include "object.h"
+
+class CallFrame;
+class CountedCall;
+class LocalRoots;
+class Function;
+class Scope;
+
+// A coroutine running a thunk on a stack of its own. Green threads of an interpreter share its
+// heap and its OS thread; they switch only in yield and when receiving from an empty channel.
+class GreenThread : public Object {
+public:
+    GreenThread(Function* body, Scope* scope);
+
+    ~GreenThread() override;
+
+    bool IsDone() const;
+
+    Function* body_;
+    Scope* scope_;
+    Object* result_{nullptr};
+
+private:
+    friend class GreenScheduler;
+
+    ucontext_t context_;
+    void* stack_{nullptr};
+    size_t depth_{0};
+    CallFrame* frame_{nullptr};
+    CountedCall* counted_{nullptr};
+    LocalRoots* roots_{nullptr};
+    // Lowest address of the stack in use when the thread was last suspended, nullptr before it
+    // first runs.
+    const void* stack_pointer_{nullptr};
+    std::exception_ptr error_;
+    bool done_{false};
+    // Set by GreenScheduler::Cancel, makes the thread unwind when it is resumed.
+    bool cancelled_{false};
+};
+
+// Unbounded FIFO queue of values. Receivers wait for a value by yielding.
+class Channel : public Object {
+public:
+    ~Channel() override = default;
+
+    void Send(Object* value);
+
+    Object* Receive();
+
+    std::deque<Object*> values_;
+    std::deque<GreenThread*> waiters_;
+};
+
+// Run queue of one interpreter. Green threads always switch back to the thread that drives the
+// scheduler (Run), which picks the next ready one.
+class GreenScheduler {
+public:
+    GreenScheduler() = default;
+
+    // Stacks of threads still suspended are freed with the threads, without destroying the C++
+    // objects on them; Cancel unwinds them first.
+    ~GreenScheduler();
+
+    GreenScheduler(const GreenScheduler&) = delete;
+
+    GreenScheduler& operator=(const GreenScheduler&) = delete;
+
+    void Spawn(GreenThread* thread);
+
+    // Inside a green thread lets the other ready threads run; outside runs each of them once.
+    void Yield();
+
+    // Suspends the current green thread until Wake is called for it.
+    void Block();
+
+    void Wake(GreenThread* thread);
+
+    // Runs ready threads until all of them are finished or blocked. Rethrows the error of the
+    // first green thread that failed.
+    void RunReady();
+
+    // Runs a single ready thread until it switches back, false if none is ready.
+    bool RunOne();
+
+    bool HasReady() const;
+
+    // Unwinds the stacks of the suspended threads, running the destructors of what is on them, and
+    // forgets the ready ones; none of them runs any further. Must be called with the heap and the
+    // builtin counters of the interpreter active, which the unwinding touches.
+    void Cancel();
+
+    // The green thread being run, nullptr on the driving thread.
+    GreenThread* Current() const;
+
+    // What the green threads that are not finished refer to: the threads, the values they hold
+    // in LocalRoots and the words of their stacks and saved registers. Suspended threads hold
+    // objects only their stacks refer to, so the heap is collected with these as roots. Must not be
+    // called from a green thread.
+    ExternalRoots GetRoots() const;
+
+private:
+    static void Start();
+
+    void Suspend();
+
+    std::deque<GreenThread*> ready_;
+    GreenThread* current_{nullptr};
+    ucontext_t main_context_;
+    // Threads spawned and not finished yet, ready or blocked.
+    std::vector<GreenThread*> threads_;
+    std::vector<void*> free_stacks_;
+};
+
+// While alive, makes GetGreenScheduler() on the current thread return scheduler.
+class ActiveGreenScheduler {
+public:
+    ActiveGreenScheduler(GreenScheduler* scheduler);
+
+    ~ActiveGreenScheduler();
+
+private:
+    GreenScheduler* prev_;
+};
+
+// Scheduler of the interpreter running on this thread, nullptr outside of one (e.g. on the
+// workers evaluating futures).
+GreenScheduler* GetGreenScheduler();
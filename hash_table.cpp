@@ -0,0 +1,130 @@
+#include "hash_table.h"
+
+#include <functional>
+#include <string>
+
+#include "garbage_collector.h"
+
+namespace {
+constexpr size_t kMinCapacity = 8;
+constexpr uint64_t kOccupied = uint64_t{1} << 63;
+
+// Finalizer of splitmix64: every bit of x affects every bit of the result, so consecutive numbers
+// and aligned addresses spread over the low bits used as the slot index.
+uint64_t Mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111eb;
+    x ^= x >> 31;
+    return x;
+}
+
+uint64_t Hash(Object* key) {
+    uint64_t hash;
+    if (auto number = As<Number>(key)) {
+        hash = Mix(number->GetValue());
+    } else if (auto symbol = As<Symbol>(key)) {
+        hash = Mix(std::hash<std::string>()(symbol->GetName()));
+    } else if (auto boolean = As<Bool>(key)) {
+        hash = Mix(boolean->GetValue() ? 2 : 1);
+    } else {
+        hash = Mix(reinterpret_cast<uintptr_t>(key));
+    }
+    return hash | kOccupied;
+}
+
+// Called only for keys with equal hashes.
+bool Equal(Object* a, Object* b) {
+    if (a == b) {
+        return true;
+    }
+    if (Is<Number>(a) && Is<Number>(b)) {
+        return As<Number>(a)->GetValue() == As<Number>(b)->GetValue();
+    }
+    if (Is<Symbol>(a) && Is<Symbol>(b)) {
+        return As<Symbol>(a)->GetName() == As<Symbol>(b)->GetName();
+    }
+    if (Is<Bool>(a) && Is<Bool>(b)) {
+        return As<Bool>(a)->GetValue() == As<Bool>(b)->GetValue();
+    }
+    return false;
+}
+}  // namespace
+
+Object** HashTable::Find(Object* key) {
+    if (slots_.empty()) {
+        return nullptr;
+    }
+    auto& slot = slots_[Probe(key, Hash(key))];
+    return slot.hash ? &slot.value : nullptr;
+}
+
+void HashTable::Set(Object* key, Object* value) {
+    auto hash = Hash(key);
+    size_t index = 0;
+    if (!slots_.empty()) {
+        index = Probe(key, hash);
+        if (slots_[index].hash) {
+            slots_[index].value = value;
+            return;
+        }
+    }
+    // At most three quarters full, so probes stay short and always reach an empty slot.
+    if ((size_ + 1) * 4 > slots_.size() * 3) {
+        Grow();
+        index = Probe(key, hash);
+    }
+    slots_[index] = Slot{hash, key, value};
+    ++size_;
+}
+
+bool HashTable::Erase(Object* key) {
+    if (slots_.empty()) {
+        return false;
+    }
+    size_t mask = slots_.size() - 1;
+    size_t hole = Probe(key, Hash(key));
+    if (!slots_[hole].hash) {
+        return false;
+    }
+    // Moves back every entry of the run after the hole that the hole doesn't come before in the
+    // entry's probe sequence, so lookups never stop at an empty slot short of their key.
+    for (size_t i = (hole + 1) & mask; slots_[i].hash; i = (i + 1) & mask) {
+        size_t home = slots_[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            slots_[hole] = slots_[i];
+            hole = i;
+        }
+    }
+    slots_[hole] = Slot{0, nullptr, nullptr};
+    --size_;
+    return true;
+}
+
+size_t HashTable::Probe(Object* key, uint64_t hash) const {
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const auto& slot = slots_[i];
+        if (!slot.hash || (slot.hash == hash && Equal(slot.key, key))) {
+            return i;
+        }
+    }
+}
+
+void HashTable::Grow() {
+    size_t capacity = slots_.empty() ? kMinCapacity : slots_.size() * 2;
+    GetGC().Charge((capacity - slots_.size()) * sizeof(Slot));
+    std::vector<Slot> old(capacity, Slot{0, nullptr, nullptr});
+    old.swap(slots_);
+    size_t mask = capacity - 1;
+    for (const auto& slot : old) {
+        if (slot.hash) {
+            size_t i = slot.hash & mask;
+            while (slots_[i].hash) {
+                i = (i + 1) & mask;
+            }
+            slots_[i] = slot;
+        }
+    }
+}
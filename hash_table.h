@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "object.h"
+
+// Mutable map from keys to values with open addressing: the entries live in one array of slots
+// probed linearly, so a lookup usually touches a single cache line and never chases pointers
+// before the key comparison. Deletion shifts the following entries back instead of leaving
+// tombstones, which keeps probe sequences short under churn.
+//
+// Numbers and booleans are equal by value and symbols by name, everything else is equal only to
+// itself. Slots cache the hash of their key, so a probe compares keys only on a hash match and
+// numbers and symbols never need a dynamic type check on a miss.
+class HashTable : public Object {
+public:
+    HashTable() = default;
+
+    ~HashTable() override = default;
+
+    // The slot holding the value for key, nullptr if key is absent. The slot is valid until the
+    // next Set or Erase.
+    Object** Find(Object* key);
+
+    // Growing the slot array is charged to the current garbage collector, so it may throw
+    // ResourceExhausted; the table is left unchanged then.
+    void Set(Object* key, Object* value);
+
+    // Returns whether key was present.
+    bool Erase(Object* key);
+
+    size_t Size() const {
+        return size_;
+    }
+
+    size_t Capacity() const {
+        return slots_.size();
+    }
+
+    // Bytes of the slot array.
+    size_t GetStorageBytes() const {
+        return slots_.capacity() * sizeof(Slot);
+    }
+
+    // Calls visit(key, value) for every entry, in slot order.
+    template <class F>
+    void ForEach(F&& visit) const {
+        for (const auto& slot : slots_) {
+            if (slot.hash) {
+                visit(slot.key, slot.value);
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        // Hash of the key with the top bit set, 0 for an empty slot.
+        uint64_t hash;
+        Object* key;
+        Object* value;
+    };
+
+    // Index of the slot holding key, or of the empty slot where it would go.
+    size_t Probe(Object* key, uint64_t hash) const;
+
+    void Grow();
+
+    std::vector<Slot> slots_;
+    size_t size_{0};
+};
@@ -0,0 +1,36 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "../heap_dump.h"
+
+// Summarizes a heap dump written by (dump-heap path) or Interpreter::DumpHeap: the bytes taken
+// by every type, then the objects retaining the most bytes with a shortest path to each.
+int main(int argc, char** argv) {
+    if (argc != 2 && argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <dump> [count]\n";
+        return 1;
+    }
+    size_t count = argc == 3 ? std::strtoul(argv[2], nullptr, 10) : 20;
+    try {
+        auto graph = ReadHeapDumpFile(argv[1]);
+        HeapAnalysis analysis(graph);
+        std::printf("%zu objects, %zu bytes\n\n", graph.nodes.size(), analysis.GetRetainedSize(0));
+        std::printf("%12s %10s  %s\n", "bytes", "objects", "type");
+        for (const auto& total : analysis.GetTypeTotals()) {
+            std::printf("%12zu %10zu  %s\n", total.bytes, total.objects, total.type.c_str());
+        }
+        std::printf("\n%12s %10s  %-16s %-16s %s\n", "retained", "bytes", "type", "label", "path");
+        for (auto node : analysis.GetTopRetainers(count)) {
+            const auto& object = graph.nodes[node];
+            auto label = object.label == HeapNode::kNoLabel ? "" : graph.strings[object.label];
+            std::printf("%12zu %10zu  %-16s %-16s %s\n", analysis.GetRetainedSize(node),
+                        object.bytes, graph.strings[object.type].c_str(), label.c_str(),
+                        analysis.GetRootPath(node).c_str());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
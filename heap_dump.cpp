@@ -0,0 +1,349 @@
+#include "heap_dump.h"
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string_view>
+#include <unordered_map>
+
+#include "error.h"
+#include "garbage_collector.h"
+#include "heap_references.h"
+#include "serialization.h"
+#include "shared_environment.h"
+
+constexpr char kHeapDumpMagic[4] = {'S', 'C', 'M', 'H'};
+constexpr uint64_t kHeapDumpVersion = 1;
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Writer
+
+namespace {
+class HeapDumpWriter {
+public:
+    void Write(Object* root, std::string* out) {
+        GetId(root);
+        for (size_t i = 0; i < order_.size(); ++i) {
+            WriteRecord(order_[i]);
+        }
+        out->append(kHeapDumpMagic, sizeof(kHeapDumpMagic));
+        PutVarint(kHeapDumpVersion, out);
+        PutVarint(strings_.size(), out);
+        for (const auto& s : strings_) {
+            PutString(s, out);
+        }
+        PutVarint(order_.size(), out);
+        out->append(records_);
+    }
+
+    size_t GetObjectCount() const {
+        return order_.size();
+    }
+
+private:
+    // Objects seen for the first time are queued, which numbers them in breadth-first order.
+    size_t GetId(Object* obj) {
+        auto it = ids_.find(obj);
+        if (it == ids_.end()) {
+            it = ids_.emplace(obj, order_.size()).first;
+            order_.push_back(obj);
+        }
+        return it->second;
+    }
+
+    size_t Intern(std::string_view s) {
+        auto it = string_ids_.find(std::string(s));
+        if (it == string_ids_.end()) {
+            it = string_ids_.emplace(s, strings_.size()).first;
+            strings_.emplace_back(s);
+        }
+        return it->second;
+    }
+
+    // Writes the index of the object's label plus one, 0 for an object without a label.
+    void PutLabel(Object* obj) {
+        if (Is<Symbol>(obj)) {
+            PutVarint(Intern(As<Symbol>(obj)->GetName()) + 1, &records_);
+        } else if (Is<Number>(obj)) {
+            PutVarint(Intern(std::to_string(As<Number>(obj)->GetValue())) + 1, &records_);
+        } else if (Is<Bool>(obj)) {
+            PutVarint(Intern(As<Bool>(obj)->GetValue() ? "#t" : "#f") + 1, &records_);
+        } else if (Is<Lambda>(obj) && Is<Symbol>(As<Lambda>(obj)->name_)) {
+            PutVarint(Intern(As<Symbol>(As<Lambda>(obj)->name_)->GetName()) + 1, &records_);
+        } else {
+            PutVarint(0, &records_);
+        }
+    }
+
+    void WriteRecord(Object* obj) {
+        bool owned = !SharedEnvironment::Owns(obj);
+        PutVarint(Intern(GetTypeName(obj)), &records_);
+        PutVarint(owned ? Footprint(obj) : 0, &records_);
+        PutLabel(obj);
+        edges_.clear();
+        if (owned) {
+            ForEachReference(obj, [&](Object* target, std::string_view label) {
+                if (target) {
+                    edges_.emplace_back(GetId(target), Intern(label));
+                }
+            });
+        }
+        PutVarint(edges_.size(), &records_);
+        for (const auto& [target, label] : edges_) {
+            PutVarint(target, &records_);
+            PutVarint(label, &records_);
+        }
+    }
+
+    std::unordered_map<Object*, size_t> ids_;
+    std::vector<Object*> order_;
+    std::unordered_map<std::string, size_t> string_ids_;
+    std::vector<std::string> strings_;
+    std::vector<std::pair<size_t, size_t>> edges_;
+    std::string records_;
+};
+}  // namespace
+
+void WriteHeapDump(Object* root, std::string* out) {
+    HeapDumpWriter().Write(root, out);
+}
+
+size_t WriteHeapDumpFile(Object* root, const std::string& path) {
+    std::string data;
+    HeapDumpWriter writer;
+    writer.Write(root, &data);
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), data.size());
+    if (!out) {
+        throw RuntimeError("Can't write heap dump " + path);
+    }
+    return writer.GetObjectCount();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Reader
+
+HeapGraph ReadHeapDump(const char* data, size_t size) {
+    ByteReader in(data, size);
+    if (!in.Expect(kHeapDumpMagic, sizeof(kHeapDumpMagic))) {
+        throw RuntimeError("Bad heap dump header");
+    }
+    if (in.GetVarint() != kHeapDumpVersion) {
+        throw RuntimeError("Unsupported heap dump version");
+    }
+    HeapGraph graph;
+    graph.strings.resize(in.GetCount());
+    for (auto& s : graph.strings) {
+        s = in.GetString();
+    }
+    auto get_string = [&] {
+        auto id = in.GetVarint();
+        if (id >= graph.strings.size()) {
+            throw RuntimeError("Bad string reference in heap dump");
+        }
+        return static_cast<size_t>(id);
+    };
+    graph.nodes.resize(in.GetCount());
+    for (auto& node : graph.nodes) {
+        node.type = get_string();
+        node.bytes = in.GetVarint();
+        auto label = in.GetVarint();
+        if (label > graph.strings.size()) {
+            throw RuntimeError("Bad string reference in heap dump");
+        }
+        node.label = label == 0 ? HeapNode::kNoLabel : label - 1;
+        node.edges.resize(in.GetCount());
+        for (auto& edge : node.edges) {
+            edge.target = in.GetVarint();
+            if (edge.target >= graph.nodes.size()) {
+                throw RuntimeError("Bad object reference in heap dump");
+            }
+            edge.label = get_string();
+        }
+    }
+    if (!in.IsEnd()) {
+        throw RuntimeError("Trailing data in heap dump");
+    }
+    if (graph.nodes.empty()) {
+        throw RuntimeError("Heap dump has no root");
+    }
+    // The writer walks from the root, so every object of a dump is reachable from it; the analysis
+    // relies on that.
+    std::vector<bool> seen(graph.nodes.size(), false);
+    std::vector<size_t> stack{0};
+    seen[0] = true;
+    size_t reached = 1;
+    while (!stack.empty()) {
+        auto v = stack.back();
+        stack.pop_back();
+        for (const auto& edge : graph.nodes[v].edges) {
+            if (!seen[edge.target]) {
+                seen[edge.target] = true;
+                ++reached;
+                stack.push_back(edge.target);
+            }
+        }
+    }
+    if (reached != graph.nodes.size()) {
+        throw RuntimeError("Heap dump has objects unreachable from the root");
+    }
+    return graph;
+}
+
+HeapGraph ReadHeapDumpFile(const std::string& path) {
+    MappedFile file(path);
+    return ReadHeapDump(file.Data(), file.Size());
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Analysis
+
+HeapAnalysis::HeapAnalysis(const HeapGraph& graph) : graph_{graph} {
+    const size_t n = graph.nodes.size();
+    constexpr size_t kNone = SIZE_MAX;
+
+    // Shortest paths from the root.
+    parents_.assign(n, kNone);
+    parent_edges_.assign(n, kNone);
+    parents_[0] = 0;
+    std::deque<size_t> queue{0};
+    while (!queue.empty()) {
+        auto v = queue.front();
+        queue.pop_front();
+        const auto& edges = graph.nodes[v].edges;
+        for (size_t i = 0; i < edges.size(); ++i) {
+            if (parents_[edges[i].target] == kNone) {
+                parents_[edges[i].target] = v;
+                parent_edges_[edges[i].target] = i;
+                queue.push_back(edges[i].target);
+            }
+        }
+    }
+
+    // Postorder of a depth-first search, with an explicit stack like the collector's marking.
+    std::vector<size_t> postorder;
+    std::vector<size_t> number(n, kNone);
+    std::vector<bool> seen(n, false);
+    std::vector<std::pair<size_t, size_t>> stack{{0, 0}};
+    seen[0] = true;
+    while (!stack.empty()) {
+        auto& [v, next] = stack.back();
+        const auto& edges = graph.nodes[v].edges;
+        if (next < edges.size()) {
+            auto target = edges[next++].target;
+            if (!seen[target]) {
+                seen[target] = true;
+                stack.emplace_back(target, 0);
+            }
+        } else {
+            number[v] = postorder.size();
+            postorder.push_back(v);
+            stack.pop_back();
+        }
+    }
+
+    std::vector<std::vector<size_t>> predecessors(n);
+    for (size_t v = 0; v < n; ++v) {
+        for (const auto& edge : graph.nodes[v].edges) {
+            predecessors[edge.target].push_back(v);
+        }
+    }
+
+    // "A Simple, Fast Dominance Algorithm" by Cooper, Harvey and Kennedy: iterate to a fixed
+    // point over the nodes in reverse postorder.
+    dominators_.assign(n, kNone);
+    dominators_[0] = 0;
+    auto intersect = [&](size_t a, size_t b) {
+        while (a != b) {
+            while (number[a] < number[b]) {
+                a = dominators_[a];
+            }
+            while (number[b] < number[a]) {
+                b = dominators_[b];
+            }
+        }
+        return a;
+    };
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+            auto v = *it;
+            if (v == 0) {
+                continue;
+            }
+            auto dominator = kNone;
+            for (auto p : predecessors[v]) {
+                if (dominators_[p] == kNone) {
+                    continue;
+                }
+                dominator = dominator == kNone ? p : intersect(p, dominator);
+            }
+            if (dominators_[v] != dominator) {
+                dominators_[v] = dominator;
+                changed = true;
+            }
+        }
+    }
+
+    // Nodes come after their dominators in reverse postorder, so postorder sums bottom-up.
+    retained_.assign(n, 0);
+    for (auto v : postorder) {
+        retained_[v] += graph.nodes[v].bytes;
+        if (v != 0) {
+            retained_[dominators_[v]] += retained_[v];
+        }
+    }
+}
+
+size_t HeapAnalysis::GetDominator(size_t node) const {
+    return dominators_[node];
+}
+
+size_t HeapAnalysis::GetRetainedSize(size_t node) const {
+    return retained_[node];
+}
+
+std::string HeapAnalysis::GetRootPath(size_t node) const {
+    std::vector<size_t> labels;
+    for (; node != 0; node = parents_[node]) {
+        labels.push_back(graph_.nodes[parents_[node]].edges[parent_edges_[node]].label);
+    }
+    std::string path;
+    for (auto it = labels.rbegin(); it != labels.rend(); ++it) {
+        if (!path.empty()) {
+            path += '.';
+        }
+        path += graph_.strings[*it];
+    }
+    return path;
+}
+
+std::vector<size_t> HeapAnalysis::GetTopRetainers(size_t count) const {
+    std::vector<size_t> nodes(graph_.nodes.size() - 1);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i] = i + 1;
+    }
+    count = std::min(count, nodes.size());
+    std::partial_sort(nodes.begin(), nodes.begin() + count, nodes.end(),
+                      [&](size_t a, size_t b) { return retained_[a] > retained_[b]; });
+    nodes.resize(count);
+    return nodes;
+}
+
+std::vector<HeapTypeTotal> HeapAnalysis::GetTypeTotals() const {
+    std::map<size_t, HeapTypeTotal> by_type;
+    for (const auto& node : graph_.nodes) {
+        auto& total = by_type[node.type];
+        total.type = graph_.strings[node.type];
+        ++total.objects;
+        total.bytes += node.bytes;
+    }
+    std::vector<HeapTypeTotal> totals;
+    for (auto& [type, total] : by_type) {
+        totals.push_back(std::move(total));
+    }
+    std::sort(totals.begin(), totals.end(),
+              [](const auto& a, const auto& b) { return a.bytes > b.bytes; });
+    return totals;
+}
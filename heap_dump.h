@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "object.h"
+
+// Heap dump: the object graph reachable from a root, written for offline analysis. The dump holds
+// a table of strings (type names, edge labels and object labels) and the objects in
+// breadth-first order from the root, which is object 0. Every object is stored as its type, its
+// footprint in bytes, an optional label (the name of a symbol or a lambda, the value of a number
+// or a boolean) and its edges, each a target object and a label such as "car" or the name of a
+// binding. Objects of a SharedEnvironment are listed with no bytes and no edges, as no single
+// heap owns them.
+//
+// The objects are those CleanUp would keep if it ran with root as its only root, so values
+// only the native stack of a running evaluation refers to are not dumped.
+void WriteHeapDump(Object* root, std::string* out);
+
+// Returns the number of objects written.
+size_t WriteHeapDumpFile(Object* root, const std::string& path);
+
+struct HeapEdge {
+    size_t target;
+    // Index in HeapGraph::strings.
+    size_t label;
+};
+
+struct HeapNode {
+    static constexpr size_t kNoLabel = SIZE_MAX;
+
+    // Indices in HeapGraph::strings; label is kNoLabel for objects without one.
+    size_t type;
+    size_t label;
+    size_t bytes;
+    std::vector<HeapEdge> edges;
+};
+
+struct HeapGraph {
+    std::vector<std::string> strings;
+    std::vector<HeapNode> nodes;
+};
+
+// Malformed input, including objects the root doesn't reach, raises RuntimeError.
+HeapGraph ReadHeapDump(const char* data, size_t size);
+
+HeapGraph ReadHeapDumpFile(const std::string& path);
+
+struct HeapTypeTotal {
+    std::string type;
+    size_t objects;
+    size_t bytes;
+};
+
+// Dominator tree of a heap graph and what it implies. A node dominates another if every path from
+// the root to the other passes through it; the retained size of a node, the bytes freed if it
+// became garbage, is its own size plus the sizes of all the nodes it dominates.
+class HeapAnalysis {
+public:
+    // Every node of graph must be reachable from the root, as in the graphs ReadHeapDump returns.
+    explicit HeapAnalysis(const HeapGraph& graph);
+
+    // The closest dominator of node; the root is its own.
+    size_t GetDominator(size_t node) const;
+
+    size_t GetRetainedSize(size_t node) const;
+
+    // Labels of the edges of a shortest path from the root to node, joined by dots, e.g.
+    // "xs.cdr.car"; empty for the root.
+    std::string GetRootPath(size_t node) const;
+
+    // The count nodes retaining the most bytes, the root left out, most first.
+    std::vector<size_t> GetTopRetainers(size_t count) const;
+
+    // Objects and bytes of every type, most bytes first.
+    std::vector<HeapTypeTotal> GetTypeTotals() const;
+
+private:
+    const HeapGraph& graph_;
+    std::vector<size_t> dominators_;
+    std::vector<size_t> retained_;
+    // The node that first reached every node in a breadth-first search, and over which edge.
+    std::vector<size_t> parents_;
+    std::vector<size_t> parent_edges_;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string_view>
+
+#include "functions.h"
+#include "hash_table.h"
+#include "object.h"
+#include "scope.h"
+
+// Calls visit(target, label) for every reference obj holds, the edges the collector follows.
+// The label names the edge: a field of obj, or the binding for a scope. Targets may be nullptr.
+// Scopes of a SharedEnvironment have no edges, the environment keeps their contents alive.
+template <class F>
+void ForEachReference(Object* obj, F&& visit) {
+    if (Is<Cell>(obj)) {
+        auto ptr = As<Cell>(obj);
+        visit(ptr->GetFirst(), "car");
+        visit(ptr->GetSecond(), "cdr");
+    } else if (Is<Vector>(obj)) {
+        for (auto el : As<Vector>(obj)->GetElements()) {
+            visit(el, "item");
+        }
+    } else if (Is<HashTable>(obj)) {
+        As<HashTable>(obj)->ForEach([&](Object* key, Object* value) {
+            visit(key, "key");
+            visit(value, "value");
+        });
+    } else if (Is<Variable>(obj)) {
+        visit(As<Variable>(obj)->var_, "value");
+    } else if (Is<LambdaGenerator>(obj)) {
+        visit(As<LambdaGenerator>(obj)->scope_, "scope");
+    } else if (Is<Lambda>(obj)) {
+        auto ptr = As<Lambda>(obj);
+        visit(ptr->par_scope_, "scope");
+        for (auto el : ptr->params_) {
+            visit(el, "param");
+        }
+        for (auto el : ptr->actions_) {
+            visit(el, "body");
+        }
+        visit(ptr->name_, "name");
+    } else if (Is<Scope>(obj)) {
+        auto ptr = As<Scope>(obj);
+        if (ptr->frozen_) {
+            return;
+        }
+        visit(ptr->par_scope_, "parent");
+        for (const auto& el : ptr->mp_) {
+            visit(el.second, std::string_view(el.first));
+        }
+    } else if (Is<Future>(obj)) {
+        auto ptr = As<Future>(obj);
+        visit(ptr->expr_, "expr");
+        visit(ptr->scope_, "scope");
+        if (ptr->IsDone()) {
+            visit(ptr->result_, "result");
+        }
+    } else if (Is<GreenThread>(obj)) {
+        auto ptr = As<GreenThread>(obj);
+        visit(ptr->body_, "body");
+        visit(ptr->scope_, "scope");
+        visit(ptr->result_, "result");
+    } else if (Is<Channel>(obj)) {
+        auto ptr = As<Channel>(obj);
+        for (auto el : ptr->values_) {
+            visit(el, "value");
+        }
+        for (auto el : ptr->waiters_) {
+            visit(el, "waiter");
+        }
+    }
+}
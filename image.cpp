@@ -0,0 +1,258 @@
+#include "image.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "error.h"
+#include "garbage_collector.h"
+#include "object.h"
+#include "serialization.h"
+
+constexpr char kImageMagic[4] = {'S', 'C', 'M', 'I'};
+constexpr uint64_t kImageVersion = 3;
+
+enum ImageOp : uint8_t {
+    kOpNil = 0,
+    kOpNumber = 1,
+    kOpSymbol = 2,
+    kOpTrue = 3,
+    kOpFalse = 4,
+    kOpPair = 5,  // element, then the rest of the list
+    kOpVector = 6,  // length, elements...
+    kOpRef = 7,  // id of a pair or a vector read before, numbered in the order they were read
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Writer
+
+class ImageWriter {
+public:
+    void WriteForm(Object* form) {
+        if (!form) {
+            code_.push_back(kOpNil);
+        } else if (Is<Number>(form)) {
+            code_.push_back(kOpNumber);
+            PutVarint(Intern(As<Number>(form)->GetValue(), &constant_ids_, &constants_), &code_);
+        } else if (Is<Symbol>(form)) {
+            code_.push_back(kOpSymbol);
+            PutVarint(Intern(As<Symbol>(form)->GetName(), &symbol_ids_, &symbols_), &code_);
+        } else if (Is<Bool>(form)) {
+            code_.push_back(As<Bool>(form)->GetValue() ? kOpTrue : kOpFalse);
+        } else if (WriteReference(form)) {
+        } else if (Is<Cell>(form)) {
+            // The pairs of a list enclose its tail, so they stay open until the list ends. Pairs
+            // after an element may have been written with it, the rest of the list is then a
+            // reference.
+            std::vector<Object*> cells;
+            do {
+                Open(form);
+                cells.push_back(form);
+                code_.push_back(kOpPair);
+                WriteForm(As<Cell>(form)->GetFirst());
+                form = As<Cell>(form)->GetSecond();
+            } while (Is<Cell>(form) && !WriteReference(form));
+            if (!Is<Cell>(form)) {
+                WriteForm(form);
+            }
+            for (auto cell : cells) {
+                open_.erase(cell);
+            }
+        } else if (Is<Vector>(form)) {
+            Open(form);
+            const auto& elements = As<Vector>(form)->GetElements();
+            code_.push_back(kOpVector);
+            PutVarint(elements.size(), &code_);
+            for (auto el : elements) {
+                WriteForm(el);
+            }
+            open_.erase(form);
+        } else {
+            throw RuntimeError("Only parsed forms can be written to an image");
+        }
+    }
+
+    void Finish(size_t form_count, std::string* out) {
+        out->append(kImageMagic, sizeof(kImageMagic));
+        PutVarint(kImageVersion, out);
+        PutVarint(symbols_.size(), out);
+        for (const auto& name : symbols_) {
+            PutString(name, out);
+        }
+        PutVarint(constants_.size(), out);
+        for (auto value : constants_) {
+            PutVarint(ZigZag(value), out);
+        }
+        PutVarint(form_count, out);
+        out->append(code_);
+    }
+
+private:
+    // Marks a pair or a vector as being written and numbers it for later references.
+    void Open(Object* form) {
+        open_.insert(form);
+        ids_.emplace(form, ids_.size());
+    }
+
+    // Refers to a pair or a vector written before, so shared structure is written once. Meeting
+    // one before it is done means the data contains itself, which the reader can't rebuild.
+    bool WriteReference(Object* form) {
+        auto it = ids_.find(form);
+        if (it == ids_.end()) {
+            return false;
+        }
+        if (open_.count(form)) {
+            throw RuntimeError("Cyclic data can't be written to an image");
+        }
+        code_.push_back(kOpRef);
+        PutVarint(it->second, &code_);
+        return true;
+    }
+
+    template <class T>
+    size_t Intern(const T& value, std::unordered_map<T, size_t>* ids, std::vector<T>* table) {
+        auto it = ids->find(value);
+        if (it != ids->end()) {
+            return it->second;
+        }
+        ids->emplace(value, table->size());
+        table->push_back(value);
+        return table->size() - 1;
+    }
+
+    std::string code_;
+    std::vector<std::string> symbols_;
+    std::unordered_map<std::string, size_t> symbol_ids_;
+    std::vector<int64_t> constants_;
+    std::unordered_map<int64_t, size_t> constant_ids_;
+    // Pairs and vectors enclosing the form being written.
+    std::unordered_set<Object*> open_;
+    std::unordered_map<Object*, size_t> ids_;
+};
+
+void WriteImage(const std::vector<Object*>& forms, std::string* out) {
+    ImageWriter writer;
+    for (auto form : forms) {
+        writer.WriteForm(form);
+    }
+    writer.Finish(forms.size(), out);
+}
+
+void WriteImageFile(const std::vector<Object*>& forms, const std::string& path) {
+    std::string data;
+    WriteImage(forms, &data);
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), data.size());
+    if (!out) {
+        throw RuntimeError("Can't write image " + path);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Reader
+
+class ImageReader {
+public:
+    ImageReader(const char* data, size_t size) : in_{data, size} {
+    }
+
+    std::vector<Object*> ReadAll() {
+        if (!in_.Expect(kImageMagic, sizeof(kImageMagic))) {
+            throw RuntimeError("Bad image header");
+        }
+        if (in_.GetVarint() != kImageVersion) {
+            throw RuntimeError("Unsupported image version");
+        }
+        symbols_.resize(in_.GetCount());
+        for (auto& symbol : symbols_) {
+            symbol = GetGC().New<Symbol>(in_.GetString());
+        }
+        constants_.resize(in_.GetCount());
+        for (auto& constant : constants_) {
+            constant = GetGC().New<Number>(UnZigZag(in_.GetVarint()));
+        }
+        std::vector<Object*> forms(in_.GetCount());
+        for (auto& form : forms) {
+            form = ReadForm();
+        }
+        if (!in_.IsEnd()) {
+            throw RuntimeError("Trailing data in image");
+        }
+        return forms;
+    }
+
+private:
+    Object* ReadForm() {
+        return ReadForm(in_.GetByte());
+    }
+
+    Object* ReadForm(uint8_t op) {
+        switch (op) {
+            case kOpNil:
+                return nullptr;
+            case kOpNumber:
+                return Lookup(constants_);
+            case kOpSymbol:
+                return Lookup(symbols_);
+            case kOpTrue:
+                return GetGC().New<Bool>(true);
+            case kOpFalse:
+                return GetGC().New<Bool>(false);
+            case kOpPair: {
+                Cell* ans(GetGC().New<Cell>());
+                Cell* last = ans;
+                while (true) {
+                    shared_.push_back(last);
+                    last->GetFirst() = ReadForm();
+                    op = in_.GetByte();
+                    if (op != kOpPair) {
+                        break;
+                    }
+                    last->GetSecond() = GetGC().New<Cell>();
+                    last = As<Cell>(last->GetSecond());
+                }
+                last->GetSecond() = ReadForm(op);
+                return ans;
+            }
+            case kOpVector: {
+                auto vector = NewVector(in_.GetCount());
+                shared_.push_back(vector);
+                for (auto& el : vector->GetElements()) {
+                    el = ReadForm();
+                }
+                return vector;
+            }
+            case kOpRef:
+                return Lookup(shared_);
+            default:
+                throw RuntimeError("Unknown opcode in image");
+        }
+    }
+
+    template <class T>
+    Object* Lookup(const std::vector<T*>& table) {
+        size_t id = in_.GetVarint();
+        if (id >= table.size()) {
+            throw RuntimeError("Bad table reference in image");
+        }
+        return table[id];
+    }
+
+    ByteReader in_;
+    std::vector<Symbol*> symbols_;
+    std::vector<Number*> constants_;
+    // Pairs and vectors in the order they were read, for references.
+    std::vector<Object*> shared_;
+};
+
+std::vector<Object*> ReadImage(const char* data, size_t size) {
+    ImageReader reader(data, size);
+    return reader.ReadAll();
+}
+
+std::vector<Object*> ReadImageFile(const std::string& path) {
+    MappedFile file(path);
+    return ReadImage(file.Data(), file.Size());
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "object.h"
+
+// Binary image of parsed top-level forms. The image holds a table of interned symbol names, a
+// pool of numeric constants and the forms themselves encoded as a stream of opcodes referring to
+// both tables, so loading it needs no tokenization. Only parsed data (cells, vectors, numbers,
+// symbols and booleans) can be stored; data containing itself is a RuntimeError, while shared
+// parts are written once and referred to afterwards.
+void WriteImage(const std::vector<Object*>& forms, std::string* out);
+
+void WriteImageFile(const std::vector<Object*>& forms, const std::string& path);
+
+// Allocates the forms in the current garbage collector. Equal symbols and constants share one
+// object.
+std::vector<Object*> ReadImage(const char* data, size_t size);
+
+// Maps the file into memory and decodes it with ReadImage.
+std::vector<Object*> ReadImageFile(const std::string& path);
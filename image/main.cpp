@@ -0,0 +1,27 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "../image.h"
+#include "../parser.h"
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <source.scm> <image>\n";
+        return 1;
+    }
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cerr << "can't open " << argv[1] << "\n";
+        return 1;
+    }
+    std::stringstream source;
+    source << in.rdbuf();
+    try {
+        WriteImageFile(ReadParallel(source.str()), argv[2]);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
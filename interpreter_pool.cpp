@@ -0,0 +1,97 @@
+#include "interpreter_pool.h"
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <utility>
+#include "scheme.h"
+
+InterpreterPool::InterpreterPool(size_t workers, size_t queue_capacity,
+                                 std::function<void(Interpreter*)> init)
+    : queue_capacity_{std::max<size_t>(queue_capacity, 1)} {
+    for (size_t i = 0; i < workers; ++i) {
+        workers_.emplace_back([this, i, init] { WorkerLoop(i, init); });
+    }
+}
+
+InterpreterPool::~InterpreterPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    not_empty_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void InterpreterPool::Submit(std::string source, Callback callback) {
+    std::unique_lock lock(mutex_);
+    not_full_.wait(lock, [this] { return queue_.size() < queue_capacity_; });
+    queue_.push_back({std::move(source), std::move(callback), std::chrono::steady_clock::now()});
+    ++unfinished_;
+    lock.unlock();
+    not_empty_.notify_one();
+}
+
+void InterpreterPool::SubmitBatch(std::vector<std::pair<std::string, Callback>> jobs) {
+    for (auto& [source, callback] : jobs) {
+        Submit(std::move(source), std::move(callback));
+    }
+}
+
+bool InterpreterPool::TrySubmit(std::string source, Callback callback) {
+    std::unique_lock lock(mutex_);
+    if (queue_.size() >= queue_capacity_) {
+        return false;
+    }
+    queue_.push_back({std::move(source), std::move(callback), std::chrono::steady_clock::now()});
+    ++unfinished_;
+    lock.unlock();
+    not_empty_.notify_one();
+    return true;
+}
+
+void InterpreterPool::Wait() {
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [this] { return unfinished_ == 0; });
+}
+
+size_t InterpreterPool::Size() const {
+    return workers_.size();
+}
+
+void InterpreterPool::WorkerLoop(size_t id, const std::function<void(Interpreter*)>& init) {
+    Interpreter interpreter;
+    if (init) {
+        init(&interpreter);
+    }
+    while (true) {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return;
+        }
+        Job job = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        not_full_.notify_one();
+
+        auto start = std::chrono::steady_clock::now();
+        JobResult result{"", true, id, start - job.submitted, {}};
+        try {
+            result.output = interpreter.Run(job.source);
+        } catch (const std::exception& e) {
+            result.output = e.what();
+            result.ok = false;
+        }
+        result.run_time = std::chrono::steady_clock::now() - start;
+        if (job.callback) {
+            job.callback(result);
+        }
+
+        lock.lock();
+        if (--unfinished_ == 0) {
+            idle_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "scheme.h"
+
+struct JobResult {
+    // Printed result of the expression, or the error message if ok is false.
+    std::string output;
+    bool ok;
+    size_t worker;
+    std::chrono::nanoseconds queue_time;
+    std::chrono::nanoseconds run_time;
+};
+
+// Runs independent expressions on a fixed set of worker threads, each owning one interpreter for
+// its whole lifetime. Definitions made by a job stay visible to later jobs on the same worker.
+// Callbacks are invoked on the worker thread and must not throw.
+class InterpreterPool {
+public:
+    using Callback = std::function<void(const JobResult&)>;
+
+    // init runs once on every fresh interpreter, e.g. to load a prelude.
+    InterpreterPool(size_t workers, size_t queue_capacity,
+                    std::function<void(Interpreter*)> init = {});
+
+    // Finishes all queued jobs before returning.
+    ~InterpreterPool();
+
+    InterpreterPool(const InterpreterPool&) = delete;
+
+    InterpreterPool& operator=(const InterpreterPool&) = delete;
+
+    // Blocks while the queue is full.
+    void Submit(std::string source, Callback callback);
+
+    void SubmitBatch(std::vector<std::pair<std::string, Callback>> jobs);
+
+    // Returns false instead of blocking when the queue is full.
+    bool TrySubmit(std::string source, Callback callback);
+
+    // Blocks until every submitted job has finished.
+    void Wait();
+
+    size_t Size() const;
+
+private:
+    struct Job {
+        std::string source;
+        Callback callback;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    void WorkerLoop(size_t id, const std::function<void(Interpreter*)>& init);
+
+    size_t queue_capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::condition_variable idle_;
+    std::deque<Job> queue_;
+    size_t unfinished_{0};
+    bool stop_{false};
+    std::vector<std::thread> workers_;
+};
@@ -0,0 +1,142 @@
+#include "message_channel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "garbage_collector.h"
+#include "green_threads.h"
+#include "image.h"
+
+Message Pack(Object* value) {
+    Message message;
+    if (!value) {
+        message.kind = Message::Kind::kNil;
+    } else if (Is<Number>(value)) {
+        message.kind = Message::Kind::kNumber;
+        message.number = As<Number>(value)->GetValue();
+    } else if (Is<Bool>(value)) {
+        message.kind = Message::Kind::kBool;
+        message.number = As<Bool>(value)->GetValue();
+    } else {
+        message.kind = Message::Kind::kImage;
+        WriteImage({value}, &message.image);
+    }
+    return message;
+}
+
+Object* Unpack(const Message& message) {
+    switch (message.kind) {
+        case Message::Kind::kNil:
+            return nullptr;
+        case Message::Kind::kNumber:
+            return GetGC().New<Number>(message.number);
+        case Message::Kind::kBool:
+            return GetGC().New<Bool>(message.number != 0);
+        case Message::Kind::kImage:
+            return ReadImage(message.image.data(), message.image.size()).front();
+    }
+    return nullptr;
+}
+
+MessageChannel::MessageChannel(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size *= 2;
+    }
+    slots_ = std::make_unique<Slot[]>(size);
+    mask_ = size - 1;
+    for (size_t i = 0; i < size; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool MessageChannel::TrySend(Message* message) {
+    auto position = send_position_.load(std::memory_order_relaxed);
+    while (true) {
+        auto& slot = slots_[position & mask_];
+        auto sequence = slot.sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (diff == 0) {
+            if (send_position_.compare_exchange_weak(position, position + 1,
+                                                     std::memory_order_relaxed)) {
+                slot.message = std::move(*message);
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            position = send_position_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool MessageChannel::TryReceive(Message* message) {
+    auto position = receive_position_.load(std::memory_order_relaxed);
+    while (true) {
+        auto& slot = slots_[position & mask_];
+        auto sequence = slot.sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+        if (diff == 0) {
+            if (receive_position_.compare_exchange_weak(position, position + 1,
+                                                        std::memory_order_relaxed)) {
+                *message = std::move(slot.message);
+                slot.sequence.store(position + mask_ + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            position = receive_position_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t MessageChannel::Capacity() const {
+    return mask_ + 1;
+}
+
+namespace {
+constexpr int kSpinsBeforeSleep = 64;
+constexpr auto kMaxSleep = std::chrono::milliseconds(1);
+
+// Repeats attempt until it succeeds. The other end lives on another thread, so waiting first
+// gives this interpreter's green threads a chance, then spins, then sleeps ever longer.
+template <class Attempt>
+void WaitFor(Attempt attempt) {
+    int failures = 0;
+    auto sleep = std::chrono::microseconds(1);
+    while (!attempt()) {
+        auto scheduler = GetGreenScheduler();
+        if (scheduler && scheduler->Current()) {
+            scheduler->Yield();
+        } else if (scheduler && scheduler->RunOne()) {
+            continue;
+        }
+        if (++failures < kSpinsBeforeSleep) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(sleep);
+            sleep = std::min<std::chrono::microseconds>(sleep * 2, kMaxSleep);
+        }
+    }
+}
+}  // namespace
+
+SharedChannel::SharedChannel(std::shared_ptr<MessageChannel> channel)
+    : channel_{std::move(channel)} {
+}
+
+void SharedChannel::Send(Object* value) {
+    auto message = Pack(value);
+    WaitFor([&] { return channel_->TrySend(&message); });
+}
+
+Object* SharedChannel::Receive() {
+    Message message;
+    WaitFor([&] { return channel_->TryReceive(&message); });
+    return Unpack(message);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "object.h"
+
+// A value on its way from one interpreter's heap to another's. Numbers, booleans and the empty
+// list travel inline; any other data is written in the image format and rebuilt by the receiver.
+struct Message {
+    enum class Kind : uint8_t { kNil, kNumber, kBool, kImage };
+
+    Kind kind{Kind::kNil};
+    int64_t number{0};
+    std::string image;
+};
+
+Message Pack(Object* value);
+
+// Allocates the value in the current garbage collector.
+Object* Unpack(const Message& message);
+
+// Bounded lock-free queue of messages (Vyukov's array queue): every slot carries a sequence
+// number telling producers and consumers whose turn it is, so any number of threads on either
+// end only contend on one compare-and-swap of the head or tail index.
+class MessageChannel {
+public:
+    // The capacity is rounded up to a power of two.
+    explicit MessageChannel(size_t capacity);
+
+    MessageChannel(const MessageChannel&) = delete;
+
+    MessageChannel& operator=(const MessageChannel&) = delete;
+
+    // Both return false instead of waiting when the channel is full or empty.
+    bool TrySend(Message* message);
+
+    bool TryReceive(Message* message);
+
+    size_t Capacity() const;
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<size_t> sequence;
+        Message message;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> send_position_{0};
+    alignas(64) std::atomic<size_t> receive_position_{0};
+};
+
+// Scheme handle of a channel shared between interpreters, see Interpreter::BindChannel. Sending
+// to a full or receiving from an empty channel lets green threads run, then backs off.
+class SharedChannel : public Object {
+public:
+    SharedChannel(std::shared_ptr<MessageChannel> channel);
+
+    ~SharedChannel() override = default;
+
+    void Send(Object* value);
+
+    Object* Receive();
+
+    std::shared_ptr<MessageChannel> channel_;
+};
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <utility>
+#include <vector>
+
 #include "error.h"
 #include "tokenizer.h"
 
@@ -70,6 +73,27 @@ private:
     Object* second_{nullptr};
 };
 
+// Fixed-size array of values, e.g. the literal #(1 2 3). The elements are stored contiguously, so
+// indexing takes constant time.
+class Vector : public Object {
+public:
+    explicit Vector(std::vector<Object*> elements) : elements_{std::move(elements)} {
+    }
+
+    ~Vector() override = default;
+
+    std::vector<Object*>& GetElements() {
+        return elements_;
+    }
+
+    const std::vector<Object*>& GetElements() const {
+        return elements_;
+    }
+
+private:
+    std::vector<Object*> elements_;
+};
+
 template <class T>
 T* As(Object* obj) {
     return dynamic_cast<T*>(obj);
@@ -0,0 +1,150 @@
+#include "parse_cache.h"
+#include "garbage_collector.h"
+#include "object.h"
+#include "parser.h"
+
+#include <utility>
+#include <vector>
+
+namespace {
+bool IsQuote(Object* form) {
+    if (!Is<Cell>(form)) {
+        return false;
+    }
+    auto head = As<Cell>(form)->GetFirst();
+    return Is<Symbol>(head) && As<Symbol>(head)->GetName() == "quote";
+}
+
+// Marks the parts of a form that evaluate to themselves as data the program may mutate: vector
+// literals and quoted data, plus the lists enclosing them, which must be copied to refer to the
+// copies. Returns whether form is marked.
+bool MarkMutable(Object* form, std::unordered_set<const Object*>* marked) {
+    bool is_mutable = Is<Vector>(form) || IsQuote(form);
+    if (!is_mutable && Is<Cell>(form)) {
+        auto rest = form;
+        for (; Is<Cell>(rest); rest = As<Cell>(rest)->GetSecond()) {
+            is_mutable |= MarkMutable(As<Cell>(rest)->GetFirst(), marked);
+        }
+        is_mutable |= MarkMutable(rest, marked);
+    }
+    if (is_mutable) {
+        marked->insert(form);
+    }
+    return is_mutable;
+}
+
+// Copies the marked parts of a cached form into the current garbage collector and shares the
+// rest.
+Object* CopyMutable(Object* form, const std::unordered_set<const Object*>& marked) {
+    if (!marked.count(form)) {
+        return form;
+    }
+    if (!Is<Cell>(form) || IsQuote(form)) {
+        return CloneForm(form, &GetGC());
+    }
+    Cell* ans(GetGC().New<Cell>());
+    if (auto location = GetGC().GetLocation(form)) {
+        GetGC().SetLocation(ans, *location);
+    }
+    Cell* last = ans;
+    while (true) {
+        last->GetFirst() = CopyMutable(As<Cell>(form)->GetFirst(), marked);
+        form = As<Cell>(form)->GetSecond();
+        if (!Is<Cell>(form)) {
+            last->GetSecond() = CopyMutable(form, marked);
+            return ans;
+        }
+        Cell* next_cell(GetGC().New<Cell>());
+        last->GetSecond() = next_cell;
+        last = next_cell;
+    }
+}
+}  // namespace
+
+Object* CloneForm(Object* form, GarbageCollector* heap) {
+    if (Is<Number>(form)) {
+        return heap->New<Number>(As<Number>(form)->GetValue());
+    } else if (Is<Symbol>(form)) {
+        return heap->New<Symbol>(As<Symbol>(form)->GetName());
+    } else if (Is<Bool>(form)) {
+        return heap->New<Bool>(As<Bool>(form)->GetValue());
+    } else if (Is<Vector>(form)) {
+        std::vector<Object*> elements;
+        for (auto el : As<Vector>(form)->GetElements()) {
+            elements.push_back(CloneForm(el, heap));
+        }
+        return heap->New<Vector>(std::move(elements));
+    } else if (!Is<Cell>(form)) {
+        return form;
+    }
+    Cell* ans(heap->New<Cell>());
+    if (auto location = GetGC().GetLocation(form)) {
+        GetGC().SetLocation(ans, *location);
+    }
+    Cell* last = ans;
+    while (true) {
+        last->GetFirst() = CloneForm(As<Cell>(form)->GetFirst(), heap);
+        form = As<Cell>(form)->GetSecond();
+        if (!Is<Cell>(form)) {
+            last->GetSecond() = CloneForm(form, heap);
+            return ans;
+        }
+        Cell* next_cell(heap->New<Cell>());
+        last->GetSecond() = next_cell;
+        last = next_cell;
+    }
+}
+
+ParseCache::ParseCache(size_t capacity, GarbageCollector* heap)
+    : capacity_{capacity}, heap_{heap} {
+}
+
+ParseCache::~ParseCache() {
+    SetCapacity(0);
+}
+
+std::vector<Object*> ParseCache::Read(const std::string& source) {
+    if (capacity_ == 0) {
+        return ::Read(source);
+    }
+    auto it = index_.find(source);
+    if (it != index_.end()) {
+        ++hits_;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        std::vector<Object*> forms;
+        forms.reserve(it->second->forms.size());
+        for (auto form : it->second->forms) {
+            forms.push_back(CopyMutable(form, it->second->mutable_parts));
+        }
+        return forms;
+    }
+    ++misses_;
+    auto forms = ::Read(source);
+    entries_.emplace_front();
+    auto& entry = entries_.front();
+    entry.source = source;
+    for (auto form : forms) {
+        entry.forms.push_back(CloneForm(form, &entry.storage));
+        MarkMutable(entry.forms.back(), &entry.mutable_parts);
+    }
+    index_.emplace(entry.source, entries_.begin());
+    Shrink();
+    return forms;
+}
+
+void ParseCache::SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    Shrink();
+}
+
+ParseCacheStats ParseCache::GetStats() const {
+    return {hits_, misses_, entries_.size(), capacity_};
+}
+
+void ParseCache::Shrink() {
+    while (entries_.size() > capacity_) {
+        index_.erase(entries_.back().source);
+        heap_->Adopt(&entries_.back().storage);
+        entries_.pop_back();
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "garbage_collector.h"
+#include "object.h"
+
+struct ParseCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t size;
+    size_t capacity;
+};
+
+// LRU cache from source text to its parsed forms. The cached forms are owned by the cache rather
+// than by the garbage collector, so they never take part in CleanUp. A hit shares the code, the
+// symbols and the numbers of the cached forms with the caller and copies only the vector
+// literals and the quoted data, which evaluate to themselves and may be mutated.
+class ParseCache {
+public:
+    // The evaluations of the forms may keep referring to them, so evicted forms are handed over
+    // to heap, which frees them once nothing does.
+    ParseCache(size_t capacity, GarbageCollector* heap);
+
+    ~ParseCache();
+
+    ParseCache(const ParseCache&) = delete;
+
+    ParseCache& operator=(const ParseCache&) = delete;
+
+    std::vector<Object*> Read(const std::string& source);
+
+    void SetCapacity(size_t capacity);
+
+    ParseCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        std::string source;
+        std::vector<Object*> forms;
+        GarbageCollector storage;
+        // Parts of the forms a hit copies, see MarkMutable.
+        std::unordered_set<const Object*> mutable_parts;
+    };
+
+    void Shrink();
+
+    size_t capacity_;
+    GarbageCollector* heap_;
+    size_t hits_{0};
+    size_t misses_{0};
+    std::list<Entry> entries_;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+};
+
+// Copies a parsed form into heap. The source locations of its lists are read from and recorded in
+// the current garbage collector, where Run looks them up whichever heap owns the lists.
+Object* CloneForm(Object* form, GarbageCollector* heap);
@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <memory>
 #include <sstream>
+#include <thread>
 #include <variant>
 #include <vector>
 
@@ -7,6 +11,7 @@
 #include "object.h"
 #include "parser.h"
 #include "tokenizer.h"
+#include "tracer.h"
 #include "garbage_collector.h"
 
 Object* ReadOneToken(Tokenizer* tokenizer) {  // expr ...
@@ -15,7 +20,12 @@ Object* ReadOneToken(Tokenizer* tokenizer) {  // expr ...
     }
     Token expr = tokenizer->GetToken();
     if (CheckOpenBracketToken(expr)) {
-        return ReadList(tokenizer);
+        auto location = tokenizer->GetLocation();
+        auto list = ReadList(tokenizer);
+        if (list) {
+            GetGC().SetLocation(list, location);
+        }
+        return list;
     } else if (CheckCloseBracketToken(expr)) {
         throw SyntaxError("close bracket in read");
     } else if (ConstantToken* x = std::get_if<ConstantToken>(&expr)) {
@@ -24,8 +34,13 @@ Object* ReadOneToken(Tokenizer* tokenizer) {  // expr ...
     } else if (SymbolToken* x = std::get_if<SymbolToken>(&expr)) {
         tokenizer->Next();
         return GetGC().New<Symbol>(x->name);
+    } else if (std::get_if<VectorToken>(&expr)) {
+        return ReadVector(tokenizer);
     } else if (std::get_if<QuoteToken>(&expr)) {
-        return ReadQuote(tokenizer);
+        auto location = tokenizer->GetLocation();
+        auto quote = ReadQuote(tokenizer);
+        GetGC().SetLocation(quote, location);
+        return quote;
     } else {
         throw SyntaxError("unknown type in read");
     }
@@ -91,7 +106,25 @@ Object* ReadList(Tokenizer* tokenizer) {  // ( expr . ... )
     throw SyntaxError("no close bracket in list");
 }
 
+Object* ReadVector(Tokenizer* tokenizer) {  // #( expr ... )
+    tokenizer->Next();
+    std::vector<Object*> elements;
+    while (!tokenizer->IsEnd()) {
+        Token expr = tokenizer->GetToken();
+        if (CheckCloseBracketToken(expr)) {
+            tokenizer->Next();
+            return GetGC().New<Vector>(std::move(elements));
+        }
+        if (CheckDotToken(expr)) {
+            throw SyntaxError("dot in vector");
+        }
+        elements.push_back(ReadOneToken(tokenizer));
+    }
+    throw SyntaxError("no close bracket in vector");
+}
+
 std::vector<Object*> Read(const std::string& s) {
+    TraceSpan span("parse", "Read");
     std::stringstream ss(s);
     Tokenizer t(&ss);
     std::vector<Object*> ans;
@@ -99,4 +132,113 @@ std::vector<Object*> Read(const std::string& s) {
         ans.push_back(Read(&t));
     }
     return ans;
-}
\ No newline at end of file
+}
+
+std::vector<Object*> ReadAll(const std::string& s, SourceLocation start) {
+    TraceSpan span("parse", "ReadAll");
+    std::stringstream ss(s);
+    Tokenizer t(&ss, start);
+    std::vector<Object*> ans;
+    while (!t.IsEnd()) {
+        ans.push_back(ReadOneToken(&t));
+    }
+    return ans;
+}
+
+constexpr size_t kMinParallelChunk = 1 << 16;
+
+struct SourceChunk {
+    size_t begin;
+    size_t end;
+    SourceLocation start;
+};
+
+// Cuts the source into pieces of roughly chunk_size bytes. A cut is only made on whitespace
+// outside of any list and not right after a quote, so every piece holds whole forms. Returns a
+// single piece if brackets are unbalanced, leaving the error to the sequential reader.
+std::vector<SourceChunk> SplitTopLevel(const std::string& s, size_t chunk_size, uint32_t file) {
+    std::vector<SourceChunk> ans{{0, s.size(), {file, 1, 1}}};
+    SourceLocation position{file, 1, 1};
+    int64_t depth = 0;
+    char last = ' ';
+    for (size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        if (c == '(') {
+            ++depth;
+        } else if (c == ')') {
+            if (--depth < 0) {
+                return {{0, s.size(), {file, 1, 1}}};
+            }
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            if (depth == 0 && last != '\'' && i - ans.back().begin >= chunk_size) {
+                ans.back().end = i;
+                ans.push_back({i, s.size(), position});
+            }
+        }
+        if (c == '\n') {
+            ++position.line;
+            position.column = 1;
+        } else {
+            ++position.column;
+        }
+        if (!std::isspace(static_cast<unsigned char>(c))) {
+            last = c;
+        }
+    }
+    return ans;
+}
+
+std::vector<Object*> ReadParallel(const std::string& s, size_t threads, uint32_t file) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (threads == 1 || s.size() < 2 * kMinParallelChunk) {
+        return ReadAll(s, {file, 1, 1});
+    }
+    // A few pieces per worker keep the load balanced when forms differ in size.
+    auto chunks =
+        SplitTopLevel(s, std::max(kMinParallelChunk, s.size() / (threads * 4)), file);
+    if (chunks.size() == 1) {
+        return ReadAll(s, {file, 1, 1});
+    }
+    threads = std::min(threads, chunks.size());
+
+    std::vector<std::vector<Object*>> parsed(chunks.size());
+    std::vector<GarbageCollector> regions(threads);
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+
+    auto worker = [&](size_t id) {
+        ActiveGC guard(&regions[id]);
+        size_t i;
+        while (!failed && (i = next++) < chunks.size()) {
+            try {
+                parsed[i] = ReadAll(s.substr(chunks[i].begin, chunks[i].end - chunks[i].begin),
+                                    chunks[i].start);
+            } catch (const std::runtime_error&) {
+                failed = true;
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t id = 1; id < threads; ++id) {
+        pool.emplace_back(worker, id);
+    }
+    worker(0);
+    for (auto& t : pool) {
+        t.join();
+    }
+
+    if (failed) {
+        // Reparse sequentially so the caller sees the same error as ReadAll would report.
+        return ReadAll(s, {file, 1, 1});
+    }
+    for (auto& region : regions) {
+        GetGC().Adopt(&region);
+    }
+    std::vector<Object*> ans;
+    for (auto& part : parsed) {
+        ans.insert(ans.end(), part.begin(), part.end());
+    }
+    return ans;
+}
@@ -10,6 +10,17 @@ Object* ReadQuote(Tokenizer* tokenizer);
 
 Object* ReadList(Tokenizer* tokenizer);
 
+Object* ReadVector(Tokenizer* tokenizer);
+
 Object* Read(Tokenizer* tokenizer);
 
-std::vector<Object*> Read(const std::string& string);
\ No newline at end of file
+std::vector<Object*> Read(const std::string& string);
+
+// Reads every top-level form of the source. Every parsed list gets its source location recorded
+// in the garbage collector; start is the location of the first character.
+std::vector<Object*> ReadAll(const std::string& string, SourceLocation start = {});
+
+// Same result as ReadAll, but splits the source at top-level form boundaries and parses
+// the pieces on up to `threads` workers (0 means one per hardware thread).
+std::vector<Object*> ReadParallel(const std::string& string, size_t threads = 0,
+                                  uint32_t file = 0);
\ No newline at end of file
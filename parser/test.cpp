@@ -3,6 +3,8 @@
 #include <sstream>
 
 #include "../error.h"
+#include "../image.h"
+#include "../garbage_collector.h"
 #include "../parser.h"
 
 auto ReadFull(const std::string& str) {
@@ -143,6 +145,20 @@ TEST_CASE("Lists") {
     }
 }
 
+TEST_CASE("Vectors") {
+    auto node = ReadFull("#(1 (2) #())");
+    REQUIRE(Is<Vector>(node));
+    auto& elements = As<Vector>(node)->GetElements();
+    REQUIRE(elements.size() == 3);
+    REQUIRE(As<Number>(elements[0])->GetValue() == 1);
+    REQUIRE(Is<Cell>(elements[1]));
+    REQUIRE(As<Vector>(elements[2])->GetElements().empty());
+
+    REQUIRE_THROWS_AS(ReadFull("#(1"), SyntaxError);
+    REQUIRE_THROWS_AS(ReadFull("#(1 . 2)"), SyntaxError);
+    REQUIRE_THROWS_AS(ReadFull("#(1))"), SyntaxError);
+}
+
 TEST_CASE("Invalid") {
     REQUIRE_THROWS_AS(ReadFull(""), SyntaxError);
     REQUIRE_THROWS_AS(ReadFull("'"), SyntaxError);
@@ -154,3 +170,85 @@ TEST_CASE("Invalid") {
     REQUIRE_THROWS_AS(ReadFull("(1 . )"), SyntaxError);
     REQUIRE_THROWS_AS(ReadFull("(1 . 2 3)"), SyntaxError);
 }
+
+TEST_CASE("Parallel read") {
+    std::default_random_engine rng{42};
+    std::string source;
+    size_t forms = 0;
+    while (source.size() < (1 << 20)) {
+        source += "(define " + RandomSymbol(&rng) + " '(1 (2 . 3) \n " + RandomSymbol(&rng) + "))\n";
+        source += "' " + RandomSymbol(&rng) + " -" + std::to_string(forms) + " ";
+        forms += 3;
+    }
+
+    auto sequential = ReadAll(source);
+    auto parallel = ReadParallel(source, 4);
+    for (size_t i = 0; i < forms; i += 3) {
+        REQUIRE(GetGC().GetLocation(parallel[i])->line == GetGC().GetLocation(sequential[i])->line);
+        REQUIRE(GetGC().GetLocation(parallel[i])->column ==
+                GetGC().GetLocation(sequential[i])->column);
+    }
+    REQUIRE(sequential.size() == forms);
+    REQUIRE(parallel.size() == forms);
+    for (size_t i = 0; i < forms; i += 3) {
+        REQUIRE(Is<Cell>(parallel[i]));
+        REQUIRE(Is<Cell>(parallel[i + 1]));
+        REQUIRE(As<Symbol>(As<Cell>(As<Cell>(parallel[i + 1])->GetSecond())->GetFirst())->GetName() ==
+                As<Symbol>(As<Cell>(As<Cell>(sequential[i + 1])->GetSecond())->GetFirst())->GetName());
+        REQUIRE(As<Number>(parallel[i + 2])->GetValue() == As<Number>(sequential[i + 2])->GetValue());
+    }
+
+    REQUIRE_THROWS_AS(ReadParallel(source + "(1 . 2 3)", 4), SyntaxError);
+    REQUIRE_THROWS_AS(ReadParallel("(1 " + source, 4), SyntaxError);
+    REQUIRE_THROWS_AS(ReadParallel(source + "(1 \xa0 2)", 4), SyntaxError);
+}
+
+TEST_CASE("Image round trip") {
+    auto forms = ReadAll("(define (f x) (* x -7)) '(a (b . c) ()) 42 f #(1 (x) #())");
+    std::string image;
+    WriteImage(forms, &image);
+
+    auto loaded = ReadImage(image.data(), image.size());
+    REQUIRE(loaded.size() == 5);
+    std::string again;
+    WriteImage(loaded, &again);
+    REQUIRE(again == image);
+
+    REQUIRE(As<Number>(loaded[2])->GetValue() == 42);
+    REQUIRE(As<Symbol>(loaded[3])->GetName() == "f");
+    REQUIRE(As<Vector>(loaded[4])->GetElements().size() == 3);
+
+    REQUIRE_THROWS_AS(ReadImage(image.data(), image.size() - 1), RuntimeError);
+    REQUIRE_THROWS_AS(ReadImage("SCMX", 4), RuntimeError);
+
+    // Structure shared within a form and across forms is written once and stays shared.
+    auto shared = ReadAll("(1 2)");
+    auto cell = GetGC().New<Cell>();
+    cell->GetFirst() = shared[0];
+    cell->GetSecond() = As<Cell>(shared[0])->GetSecond();
+    image.clear();
+    WriteImage({cell, shared[0]}, &image);
+    loaded = ReadImage(image.data(), image.size());
+    REQUIRE(loaded.size() == 2);
+    REQUIRE(As<Cell>(loaded[0])->GetFirst() == loaded[1]);
+    REQUIRE(As<Cell>(loaded[0])->GetSecond() == As<Cell>(loaded[1])->GetSecond());
+}
+
+TEST_CASE("Source locations") {
+    auto file = InternSourceFile("test.scm");
+    auto forms = ReadAll("(define x\n  '(1 2))\n\n   (+ x\n (car x))", {file, 1, 1});
+    REQUIRE(forms.size() == 2);
+
+    auto location = GetGC().GetLocation(forms[0]);
+    REQUIRE(location);
+    REQUIRE(ToString(*location) == "test.scm:1:1");
+
+    auto quote = As<Cell>(As<Cell>(As<Cell>(forms[0])->GetSecond())->GetSecond())->GetFirst();
+    REQUIRE(ToString(*GetGC().GetLocation(quote)) == "test.scm:2:3");
+
+    REQUIRE(ToString(*GetGC().GetLocation(forms[1])) == "test.scm:4:4");
+    auto car = As<Cell>(As<Cell>(As<Cell>(forms[1])->GetSecond())->GetSecond())->GetFirst();
+    REQUIRE(ToString(*GetGC().GetLocation(car)) == "test.scm:5:2");
+
+    REQUIRE(!GetGC().GetLocation(As<Cell>(forms[1])->GetSecond()));
+}
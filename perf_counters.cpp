@@ -0,0 +1,122 @@
+#include "perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <utility>
+
+namespace {
+constexpr uint64_t kConfigs[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                 PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+int OpenCounter(uint64_t config) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    // Counting the kernel takes privileges containers rarely have.
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+std::chrono::nanoseconds GetCpuTime() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec);
+}
+
+void AddLine(const char* name, uint64_t value, std::string* out) {
+    *out += name;
+    *out += " " + std::to_string(value) + "\n";
+}
+}  // namespace
+
+std::string FormatPerfReport(const PerfReport& report) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    std::string out;
+    AddLine("wall-time", duration_cast<microseconds>(report.wall_time).count(), &out);
+    AddLine("cpu-time", duration_cast<microseconds>(report.cpu_time).count(), &out);
+    const std::pair<const char*, const std::optional<uint64_t>&> counters[] = {
+        {"cycles", report.cycles},
+        {"instructions", report.instructions},
+        {"cache-misses", report.cache_misses},
+        {"branch-misses", report.branch_misses}};
+    for (const auto& [name, value] : counters) {
+        if (value) {
+            AddLine(name, *value, &out);
+        }
+    }
+    return out;
+}
+
+PerfCounters::PerfCounters() {
+    for (int counter = 0; counter < kCounters; ++counter) {
+        fds_[counter] = OpenCounter(kConfigs[counter]);
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (auto fd : fds_) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool PerfCounters::HasHardwareCounters() const {
+    for (auto fd : fds_) {
+        if (fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PerfCounters::Start() {
+    for (auto fd : fds_) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    cpu_start_ = GetCpuTime();
+    wall_start_ = std::chrono::steady_clock::now();
+}
+
+PerfReport PerfCounters::Stop() {
+    PerfReport report;
+    report.wall_time = std::chrono::steady_clock::now() - wall_start_;
+    report.cpu_time = GetCpuTime() - cpu_start_;
+    for (auto fd : fds_) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    report.cycles = Read(kCycles);
+    report.instructions = Read(kInstructions);
+    report.cache_misses = Read(kCacheMisses);
+    report.branch_misses = Read(kBranchMisses);
+    return report;
+}
+
+std::optional<uint64_t> PerfCounters::Read(Counter counter) const {
+    if (fds_[counter] < 0) {
+        return std::nullopt;
+    }
+    // The value, the time the counter was enabled and the time it was actually counting.
+    uint64_t values[3];
+    if (read(fds_[counter], values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+        return std::nullopt;
+    }
+    if (values[2] == values[1]) {
+        return values[0];
+    }
+    return static_cast<uint64_t>(static_cast<double>(values[0]) * values[1] / values[2]);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// What a piece of work cost the thread that ran it.
+struct PerfReport {
+    std::chrono::nanoseconds wall_time{0};
+    std::chrono::nanoseconds cpu_time{0};
+    // Hardware counters of user-space execution, scaled up if the kernel had to multiplex them.
+    // Empty where the CPU or the container doesn't provide them, e.g. in most virtual machines.
+    std::optional<uint64_t> cycles;
+    std::optional<uint64_t> instructions;
+    std::optional<uint64_t> cache_misses;
+    std::optional<uint64_t> branch_misses;
+};
+
+// report as "name value" lines, times in microseconds; missing counters are left out.
+std::string FormatPerfReport(const PerfReport& report);
+
+// Counts the work of the thread that created it between Start and Stop, with perf_event_open
+// where it is allowed and with the wall and CPU clocks always. The same thread must call Start
+// and Stop.
+//
+//     PerfCounters counters;
+//     counters.Start();
+//     interpreter.Run(expr);
+//     auto report = counters.Stop();
+class PerfCounters {
+public:
+    PerfCounters();
+
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Whether any hardware counter could be opened.
+    bool HasHardwareCounters() const;
+
+    void Start();
+
+    PerfReport Stop();
+
+private:
+    enum Counter { kCycles, kInstructions, kCacheMisses, kBranchMisses, kCounters };
+
+    std::optional<uint64_t> Read(Counter counter) const;
+
+    // Descriptors of the counters, -1 for those that are unavailable.
+    std::array<int, kCounters> fds_;
+    std::chrono::steady_clock::time_point wall_start_;
+    std::chrono::nanoseconds cpu_start_{0};
+};
@@ -0,0 +1,220 @@
+#include "process_pool.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <utility>
+
+#include "error.h"
+
+namespace {
+enum FrameStatus : char {
+    kFrameOk = 0,
+    kFrameError = 1,
+};
+
+bool WriteFull(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        auto written = send(fd, data, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool ReadFull(int fd, char* data, size_t size) {
+    while (size > 0) {
+        auto received = read(fd, data, size);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+// A frame is a 4-byte length followed by that many bytes.
+bool SendFrame(int fd, const std::string& payload) {
+    uint32_t size = payload.size();
+    char header[sizeof(size)];
+    std::memcpy(header, &size, sizeof(size));
+    return WriteFull(fd, header, sizeof(header)) && WriteFull(fd, payload.data(), size);
+}
+
+bool ReceiveFrame(int fd, std::string* payload) {
+    char header[sizeof(uint32_t)];
+    if (!ReadFull(fd, header, sizeof(header))) {
+        return false;
+    }
+    uint32_t size;
+    std::memcpy(&size, header, sizeof(size));
+    payload->resize(size);
+    return ReadFull(fd, payload->data(), size);
+}
+
+// Body of a worker process: answers every request frame with a status byte and the output.
+[[noreturn]] void Serve(Interpreter* interpreter, int fd) {
+    std::string expr;
+    while (ReceiveFrame(fd, &expr)) {
+        std::string reply(1, kFrameOk);
+        try {
+            reply += interpreter->Run(expr);
+        } catch (const std::exception& e) {
+            reply = std::string(1, kFrameError) + e.what();
+        }
+        if (!SendFrame(fd, reply)) {
+            break;
+        }
+    }
+    _exit(0);
+}
+}  // namespace
+
+ProcessPool::ProcessPool(Interpreter* prototype, size_t workers)
+    : prototype_{prototype}, workers_(workers) {
+    for (size_t i = 0; i < workers; ++i) {
+        Start(i);
+    }
+}
+
+ProcessPool::~ProcessPool() {
+    for (auto& worker : workers_) {
+        Stop(&worker);
+    }
+}
+
+size_t ProcessPool::Submit(std::string expr) {
+    queue_.push_back({next_id_, std::move(expr), Clock::now()});
+    return next_id_++;
+}
+
+bool ProcessPool::Next(size_t* id, JobResult* result) {
+    while (true) {
+        Dispatch();
+        std::vector<pollfd> fds;
+        std::vector<size_t> indices;
+        for (size_t i = 0; i < workers_.size(); ++i) {
+            if (workers_[i].busy) {
+                fds.push_back({workers_[i].fd, POLLIN, 0});
+                indices.push_back(i);
+            }
+        }
+        if (fds.empty()) {
+            return false;
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw RuntimeError("Can't wait for worker processes");
+        }
+        for (size_t k = 0; k < fds.size(); ++k) {
+            if (!fds[k].revents) {
+                continue;
+            }
+            auto& worker = workers_[indices[k]];
+            std::string reply;
+            bool received = ReceiveFrame(worker.fd, &reply) && !reply.empty();
+            *id = worker.job;
+            result->worker = indices[k];
+            result->queue_time = worker.started - worker.submitted;
+            result->run_time = Clock::now() - worker.started;
+            worker.busy = false;
+            if (received) {
+                result->ok = reply[0] == kFrameOk;
+                result->output = reply.substr(1);
+            } else {
+                result->ok = false;
+                result->output = "Worker process died";
+                Stop(&worker);
+                Start(indices[k]);
+                ++restarts_;
+            }
+            return true;
+        }
+    }
+}
+
+size_t ProcessPool::Size() const {
+    return workers_.size();
+}
+
+size_t ProcessPool::Restarts() const {
+    return restarts_;
+}
+
+void ProcessPool::Start(size_t index) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+        throw RuntimeError("Can't create a socket for a worker process");
+    }
+    auto pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        throw RuntimeError("Can't fork a worker process");
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        for (const auto& worker : workers_) {
+            if (worker.fd >= 0) {
+                close(worker.fd);
+            }
+        }
+        Serve(prototype_, fds[1]);
+    }
+    close(fds[1]);
+    workers_[index] = Worker{};
+    workers_[index].pid = pid;
+    workers_[index].fd = fds[0];
+}
+
+void ProcessPool::Stop(Worker* worker) {
+    if (worker->busy && worker->pid > 0) {
+        // A job that is still running may never finish.
+        kill(worker->pid, SIGKILL);
+    }
+    if (worker->fd >= 0) {
+        close(worker->fd);
+        worker->fd = -1;
+    }
+    if (worker->pid > 0) {
+        while (waitpid(worker->pid, nullptr, 0) < 0 && errno == EINTR) {
+        }
+        worker->pid = -1;
+    }
+}
+
+void ProcessPool::Dispatch() {
+    for (size_t i = 0; i < workers_.size() && !queue_.empty(); ++i) {
+        auto& worker = workers_[i];
+        if (worker.busy) {
+            continue;
+        }
+        auto job = std::move(queue_.front());
+        queue_.pop_front();
+        worker.busy = true;
+        worker.job = job.id;
+        worker.submitted = job.submitted;
+        worker.started = Clock::now();
+        // A failed send shows up as a dead worker once its reply is awaited.
+        SendFrame(worker.fd, job.expr);
+    }
+}
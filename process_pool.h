@@ -0,0 +1,73 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "interpreter_pool.h"
+#include "scheme.h"
+
+// Runs expressions in forked copies of a warmed-up interpreter, one process per worker, for
+// isolation between jobs of different tenants. The children share the prototype's heap
+// copy-on-write; the collector keeps its marks in a side table, so collections in a child only
+// touch pages of objects that actually die. Jobs and results are framed over a Unix socket pair
+// per worker. A worker that dies is replaced by a fresh fork and its job fails.
+//
+// The pool forks the calling process, so it should be created before other threads are started.
+class ProcessPool {
+public:
+    // The prototype is only read by the children and must outlive the pool.
+    ProcessPool(Interpreter* prototype, size_t workers);
+
+    // Closes the sockets, which makes the workers exit, and reaps them.
+    ~ProcessPool();
+
+    ProcessPool(const ProcessPool&) = delete;
+
+    ProcessPool& operator=(const ProcessPool&) = delete;
+
+    // Queues expr and returns its id; ids are consecutive starting from 0.
+    size_t Submit(std::string expr);
+
+    // Blocks until some job is finished, false if no job is queued or running.
+    bool Next(size_t* id, JobResult* result);
+
+    size_t Size() const;
+
+    // Number of workers that were replaced after dying.
+    size_t Restarts() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        size_t id;
+        std::string expr;
+        Clock::time_point submitted;
+    };
+
+    struct Worker {
+        pid_t pid{-1};
+        int fd{-1};
+        bool busy{false};
+        size_t job{0};
+        Clock::time_point submitted;
+        Clock::time_point started;
+    };
+
+    void Start(size_t index);
+
+    void Stop(Worker* worker);
+
+    void Dispatch();
+
+    Interpreter* prototype_;
+    std::vector<Worker> workers_;
+    std::deque<Job> queue_;
+    size_t next_id_{0};
+    size_t restarts_{0};
+};
@@ -0,0 +1,381 @@
+#include "profiler.h"
+
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <utility>
+
+#include "error.h"
+#include "functions.h"
+#include "garbage_collector.h"
+#include "scope.h"
+
+namespace {
+thread_local CallFrame* innermost_frame = nullptr;
+thread_local ActiveProfiler* active_profiler = nullptr;
+// Written by the signal handler, which runs on the profiled thread itself.
+thread_local std::atomic<size_t> due_samples{0};
+thread_local BuiltinStats* current_builtin_stats = nullptr;
+thread_local CountedCall* innermost_counted = nullptr;
+
+void OnTimer(int) {
+    due_samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+void InstallHandler() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        struct sigaction action {};
+        action.sa_handler = OnTimer;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGPROF, &action, nullptr);
+    });
+}
+}  // namespace
+
+thread_local BuiltinStats* counted_builtins = nullptr;
+
+CallFrame::CallFrame(Function* function) : function_{function}, parent_{innermost_frame} {
+    innermost_frame = this;
+}
+
+CallFrame::~CallFrame() {
+    innermost_frame = parent_;
+}
+
+CallFrame* ExchangeCallFrame(CallFrame* frame) {
+    return std::exchange(innermost_frame, frame);
+}
+
+const CallFrame* GetInnermostFrame() {
+    return innermost_frame;
+}
+
+void FrameNames::AddNames(Scope* scope) {
+    for (; scope; scope = scope->par_scope_) {
+        for (const auto& [name, value] : scope->mp_) {
+            if (IsBuiltin(value)) {
+                names_.emplace(value, name);
+            }
+        }
+    }
+}
+
+std::string FrameNames::GetName(Function* function) const {
+    if (Is<Lambda>(function)) {
+        auto name = As<Lambda>(function)->name_;
+        return name ? As<Symbol>(name)->GetName() : "lambda";
+    }
+    if (Is<LambdaGenerator>(function)) {
+        return "lambda";
+    }
+    auto it = names_.find(function);
+    return it == names_.end() ? "builtin" : it->second;
+}
+
+std::string FrameNames::Fold(const CallFrame* top, const CallFrame* bottom,
+                             size_t max_depth) const {
+    std::vector<const CallFrame*> frames;
+    for (auto frame = top; frame && frame != bottom && frames.size() < max_depth;
+         frame = frame->parent_) {
+        frames.push_back(frame);
+    }
+    std::string stack;
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+        if (!stack.empty()) {
+            stack += ';';
+        }
+        stack += GetName((*it)->function_);
+    }
+    if (stack.empty()) {
+        stack = "[top level]";
+    }
+    return stack;
+}
+
+SamplingProfiler::SamplingProfiler(std::chrono::microseconds interval) : interval_{interval} {
+}
+
+void SamplingProfiler::AddNames(Scope* scope) {
+    names_.AddNames(scope);
+}
+
+std::string SamplingProfiler::GetFoldedStacks() const {
+    std::string out;
+    for (const auto& [stack, count] : stacks_) {
+        out += stack + " " + std::to_string(count) + "\n";
+    }
+    return out;
+}
+
+size_t SamplingProfiler::GetSampleCount() const {
+    return samples_;
+}
+
+std::chrono::microseconds SamplingProfiler::GetInterval() const {
+    return interval_;
+}
+
+void SamplingProfiler::Record(const CallFrame* top, const CallFrame* bottom, size_t count) {
+    stacks_[names_.Fold(top, bottom)] += count;
+    samples_ += count;
+}
+
+ActiveProfiler::ActiveProfiler(SamplingProfiler* profiler) : profiler_{profiler} {
+    if (!profiler_) {
+        return;
+    }
+    InstallHandler();
+    sigevent event{};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    // glibc has no name for the target thread field.
+    event._sigev_un._tid = static_cast<pid_t>(syscall(SYS_gettid));
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer_) != 0) {
+        throw RuntimeError("Can't create a profiling timer");
+    }
+    prev_ = std::exchange(active_profiler, this);
+    if (prev_) {
+        prev_->Arm(false);
+    }
+    bottom_ = innermost_frame;
+    due_samples = 0;
+    Arm(true);
+}
+
+ActiveProfiler::~ActiveProfiler() {
+    if (!profiler_) {
+        return;
+    }
+    timer_delete(timer_);
+    due_samples = 0;
+    active_profiler = prev_;
+    if (prev_) {
+        prev_->Arm(true);
+    }
+}
+
+void ActiveProfiler::Arm(bool on) {
+    itimerspec spec{};
+    if (on) {
+        auto interval = profiler_->GetInterval();
+        spec.it_interval.tv_sec = interval.count() / 1000000;
+        spec.it_interval.tv_nsec = interval.count() % 1000000 * 1000;
+        spec.it_value = spec.it_interval;
+    }
+    timer_settime(timer_, 0, &spec, nullptr);
+}
+
+bool IsProfiling() {
+    return active_profiler != nullptr;
+}
+
+void RecordDueSamples() {
+    if (!active_profiler) {
+        return;
+    }
+    auto count = due_samples.exchange(0, std::memory_order_relaxed);
+    if (count > 0) {
+        active_profiler->profiler_->Record(innermost_frame, active_profiler->bottom_, count);
+    }
+}
+
+AllocationProfiler::AllocationProfiler(size_t interval)
+    : interval_{std::max<size_t>(interval, 1)}, countdown_{interval_} {
+}
+
+void AllocationProfiler::AddNames(Scope* scope) {
+    names_.AddNames(scope);
+}
+
+void AllocationProfiler::Sample(const Object* obj, size_t bytes) {
+    auto key = std::make_pair(names_.Fold(innermost_frame, nullptr, kSiteDepth), GetTypeName(obj));
+    auto it = site_ids_.find(key);
+    if (it == site_ids_.end()) {
+        it = site_ids_.emplace(key, sites_.size()).first;
+        sites_.emplace_back();
+        sites_.back().stack = key.first;
+        sites_.back().type = key.second;
+    }
+    auto& site = sites_[it->second];
+    site.objects += interval_;
+    site.bytes += bytes * interval_;
+    pending_[obj] = it->second;
+}
+
+void AllocationProfiler::OnCollection(const std::unordered_set<Object*>& live) {
+    for (const auto& [obj, id] : pending_) {
+        ++sites_[id].collected;
+        if (live.count(const_cast<Object*>(obj))) {
+            ++sites_[id].survived;
+        }
+    }
+    pending_.clear();
+}
+
+std::vector<AllocationSite> AllocationProfiler::GetTopSites(size_t count) const {
+    auto sites = sites_;
+    std::sort(sites.begin(), sites.end(),
+              [](const auto& a, const auto& b) { return a.bytes > b.bytes; });
+    sites.resize(std::min(count, sites.size()));
+    return sites;
+}
+
+std::string AllocationProfiler::GetReport(size_t count) const {
+    std::string out;
+    char line[128];
+    std::snprintf(line, sizeof(line), "%12s %10s %8s  %-16s %s\n", "bytes", "objects", "survived",
+                  "type", "stack");
+    out += line;
+    for (const auto& site : GetTopSites(count)) {
+        if (site.collected > 0) {
+            std::snprintf(line, sizeof(line), "%12zu %10zu %7.1f%%  %-16s ", site.bytes,
+                          site.objects, 100.0 * site.survived / site.collected, site.type.c_str());
+        } else {
+            std::snprintf(line, sizeof(line), "%12zu %10zu %8s  %-16s ", site.bytes, site.objects,
+                          "-", site.type.c_str());
+        }
+        out += line + site.stack + "\n";
+    }
+    return out;
+}
+
+size_t AllocationProfiler::GetInterval() const {
+    return interval_;
+}
+
+void BuiltinStats::SetEnabled(bool on) {
+    enabled_ = on;
+    if (current_builtin_stats == this) {
+        counted_builtins = on ? this : nullptr;
+    }
+}
+
+bool BuiltinStats::IsEnabled() const {
+    return enabled_;
+}
+
+std::vector<BuiltinCounters> BuiltinStats::GetCounters() const {
+    auto counters = counters_;
+    std::sort(counters.begin(), counters.end(),
+              [](const auto& a, const auto& b) { return a.self_time > b.self_time; });
+    return counters;
+}
+
+void BuiltinStats::Reset() {
+    counters_.clear();
+    ids_.clear();
+}
+
+BuiltinCounters& BuiltinStats::GetCounters(Function* function, Scope* scope) {
+    auto it = ids_.find(function);
+    if (it != ids_.end()) {
+        return counters_[it->second];
+    }
+    std::string name = "builtin";
+    for (; scope && name == "builtin"; scope = scope->par_scope_) {
+        for (const auto& [binding, value] : scope->mp_) {
+            if (value == function) {
+                name = binding;
+                break;
+            }
+        }
+    }
+    // Aliases of one builtin share its counters.
+    for (size_t id = 0; id < counters_.size(); ++id) {
+        if (counters_[id].name == name) {
+            ids_.emplace(function, id);
+            return counters_[id];
+        }
+    }
+    ids_.emplace(function, counters_.size());
+    counters_.emplace_back();
+    counters_.back().name = name;
+    return counters_.back();
+}
+
+ActiveBuiltinStats::ActiveBuiltinStats(BuiltinStats* stats) : stats_{stats} {
+    if (!stats_) {
+        return;
+    }
+    prev_ = std::exchange(current_builtin_stats, stats_);
+    counted_builtins = stats_->IsEnabled() ? stats_ : nullptr;
+}
+
+ActiveBuiltinStats::~ActiveBuiltinStats() {
+    if (!stats_) {
+        return;
+    }
+    current_builtin_stats = prev_;
+    counted_builtins = prev_ && prev_->IsEnabled() ? prev_ : nullptr;
+}
+
+BuiltinStats* GetBuiltinStats() {
+    return current_builtin_stats;
+}
+
+class CountedCall {
+public:
+    CountedCall(BuiltinStats* stats, Function* function, Object* form, Scope* scope)
+        : stats_{stats},
+          function_{function},
+          form_{form},
+          scope_{scope},
+          parent_{std::exchange(innermost_counted, this)},
+          allocations_{GetGC().GetAllocationCount()},
+          start_{std::chrono::steady_clock::now()} {
+    }
+
+    ~CountedCall() {
+        auto time = std::chrono::steady_clock::now() - start_;
+        auto allocations = GetGC().GetAllocationCount() - allocations_;
+        innermost_counted = parent_;
+        if (parent_) {
+            parent_->nested_time_ += time;
+            parent_->nested_allocations_ += allocations;
+        }
+        if (!IsBuiltin(function_)) {
+            return;
+        }
+        auto& counters = stats_->GetCounters(function_, scope_);
+        ++counters.calls;
+        for (auto arg = As<Cell>(form_)->GetSecond(); Is<Cell>(arg);
+             arg = As<Cell>(arg)->GetSecond()) {
+            ++counters.arguments;
+        }
+        counters.allocations += allocations - nested_allocations_;
+        counters.time += time;
+        counters.self_time += time - nested_time_;
+    }
+
+    CountedCall(const CountedCall&) = delete;
+
+    CountedCall& operator=(const CountedCall&) = delete;
+
+private:
+    BuiltinStats* stats_;
+    Function* function_;
+    Object* form_;
+    Scope* scope_;
+    CountedCall* parent_;
+    size_t allocations_;
+    size_t nested_allocations_{0};
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::nanoseconds nested_time_{0};
+};
+
+CountedCall* ExchangeCountedCall(CountedCall* call) {
+    return std::exchange(innermost_counted, call);
+}
+
+Object* InvokeCounted(Function* function, Object* form, Scope* scope) {
+    CountedCall call(counted_builtins, function, form, scope);
+    CallFrame frame(function);
+    return function->Invoke(form, scope);
+}
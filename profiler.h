@@ -0,0 +1,242 @@
+#pragma once
+
+#include <time.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+class Function;
+class Object;
+class Scope;
+
+// A Scheme call in progress. Frames live on the native stack of the evaluation and link up to
+// the innermost frame of the current thread, so the sampler can walk the Scheme call stack.
+class CallFrame {
+public:
+    CallFrame(Function* function);
+
+    ~CallFrame();
+
+    CallFrame(const CallFrame&) = delete;
+
+    CallFrame& operator=(const CallFrame&) = delete;
+
+    Function* function_;
+    CallFrame* parent_;
+};
+
+// Replaces the innermost frame of the current thread. Green threads keep call stacks of their
+// own, which are swapped in whenever they are switched to.
+CallFrame* ExchangeCallFrame(CallFrame* frame);
+
+const CallFrame* GetInnermostFrame();
+
+// Names the functions of call stacks: lambdas after the define that first bound them, builtins
+// after their bindings in the scopes passed to AddNames.
+class FrameNames {
+public:
+    void AddNames(Scope* scope);
+
+    std::string GetName(Function* function) const;
+
+    // "outer;...;inner" for the frames from top up to bottom, which is left out. Only the
+    // max_depth innermost frames are named.
+    std::string Fold(const CallFrame* top, const CallFrame* bottom,
+                     size_t max_depth = SIZE_MAX) const;
+
+private:
+    std::unordered_map<const Object*, std::string> names_;
+};
+
+// Counts the Scheme call stacks seen by the samples taken while an ActiveProfiler for it is
+// alive.
+class SamplingProfiler {
+public:
+    // Interval between two samples, in CPU time of the profiled thread.
+    explicit SamplingProfiler(std::chrono::microseconds interval = std::chrono::milliseconds(1));
+
+    void AddNames(Scope* scope);
+
+    // One "outer;...;inner count" line per distinct stack, the format flamegraph.pl reads.
+    std::string GetFoldedStacks() const;
+
+    size_t GetSampleCount() const;
+
+    std::chrono::microseconds GetInterval() const;
+
+private:
+    friend void RecordDueSamples();
+
+    void Record(const CallFrame* top, const CallFrame* bottom, size_t count);
+
+    std::chrono::microseconds interval_;
+    FrameNames names_;
+    std::map<std::string, size_t> stacks_;
+    size_t samples_{0};
+};
+
+// While alive, samples the current thread into profiler; nullptr does nothing. Only the frames
+// entered after the guard are recorded. A nested guard suspends the enclosing one.
+//
+// A SIGPROF timer on the thread's CPU clock marks samples as due. The stack is recorded at the
+// next budget check (see CheckBudget), which comes more often while profiling, so the signal
+// handler never touches the heap.
+class ActiveProfiler {
+public:
+    ActiveProfiler(SamplingProfiler* profiler);
+
+    ~ActiveProfiler();
+
+    ActiveProfiler(const ActiveProfiler&) = delete;
+
+    ActiveProfiler& operator=(const ActiveProfiler&) = delete;
+
+private:
+    friend void RecordDueSamples();
+    friend bool IsProfiling();
+
+    void Arm(bool on);
+
+    SamplingProfiler* profiler_;
+    ActiveProfiler* prev_{nullptr};
+    const CallFrame* bottom_{nullptr};
+    timer_t timer_;
+};
+
+bool IsProfiling();
+
+// Records the samples that have come due on the current thread, if it is being profiled.
+void RecordDueSamples();
+
+// Allocations of one type made under one call stack, as estimated from the samples.
+struct AllocationSite {
+    // Innermost frames of the stack, folded like the stacks of SamplingProfiler.
+    std::string stack;
+    std::string type;
+    size_t objects{0};
+    size_t bytes{0};
+    // Sampled objects whose first collection has run, and how many of them it kept.
+    size_t collected{0};
+    size_t survived{0};
+};
+
+// Samples one in every interval allocations of the collectors it is attached to (see
+// GarbageCollector::SetAllocationProfiler) and attributes them to the Scheme call stack. Every
+// sampled object is followed to the first collection after it, to tell short-lived garbage
+// from data that is kept.
+class AllocationProfiler {
+public:
+    explicit AllocationProfiler(size_t interval = 64);
+
+    void AddNames(Scope* scope);
+
+    void OnAllocation(const Object* obj, size_t bytes) {
+        if (--countdown_ == 0) {
+            countdown_ = interval_;
+            Sample(obj, bytes);
+        }
+    }
+
+    // Settles the survival of the objects sampled since the previous collection.
+    void OnCollection(const std::unordered_set<Object*>& live);
+
+    // The count sites that allocated the most bytes, most first.
+    std::vector<AllocationSite> GetTopSites(size_t count) const;
+
+    // GetTopSites as a table.
+    std::string GetReport(size_t count) const;
+
+    size_t GetInterval() const;
+
+private:
+    // Frames of a site: enough to tell the callers of a helper apart.
+    static constexpr size_t kSiteDepth = 16;
+
+    void Sample(const Object* obj, size_t bytes);
+
+    size_t interval_;
+    size_t countdown_;
+    FrameNames names_;
+    std::vector<AllocationSite> sites_;
+    std::map<std::pair<std::string, std::string>, size_t> site_ids_;
+    // Sampled objects that haven't been through a collection yet, with their sites.
+    std::unordered_map<const Object*, size_t> pending_;
+};
+
+// Calls of one builtin, as counted by BuiltinStats.
+struct BuiltinCounters {
+    std::string name;
+    uint64_t calls{0};
+    // Argument forms passed, evaluated or not.
+    uint64_t arguments{0};
+    // Objects allocated by the calls themselves, not by the functions they called in turn.
+    uint64_t allocations{0};
+    // Time from entering the calls to leaving them, and the part of it not spent in nested calls
+    // of builtins or lambdas.
+    std::chrono::nanoseconds time{0};
+    std::chrono::nanoseconds self_time{0};
+};
+
+// Counts the calls of builtins evaluated while an ActiveBuiltinStats for it is alive. Counting
+// starts disabled and may be switched on and off at any time, even in the middle of a call.
+class BuiltinStats {
+public:
+    void SetEnabled(bool on);
+
+    bool IsEnabled() const;
+
+    // Counters of every builtin called so far, most self time first.
+    std::vector<BuiltinCounters> GetCounters() const;
+
+    void Reset();
+
+private:
+    friend class CountedCall;
+
+    // Counters of function, named after its binding seen from scope on the first call.
+    BuiltinCounters& GetCounters(Function* function, Scope* scope);
+
+    bool enabled_{false};
+    std::vector<BuiltinCounters> counters_;
+    std::unordered_map<const Function*, size_t> ids_;
+};
+
+// While alive, makes stats the table of the current thread; nullptr does nothing.
+class ActiveBuiltinStats {
+public:
+    ActiveBuiltinStats(BuiltinStats* stats);
+
+    ~ActiveBuiltinStats();
+
+    ActiveBuiltinStats(const ActiveBuiltinStats&) = delete;
+
+    ActiveBuiltinStats& operator=(const ActiveBuiltinStats&) = delete;
+
+private:
+    BuiltinStats* stats_;
+    BuiltinStats* prev_{nullptr};
+};
+
+// The table of the current thread, nullptr if there is none.
+BuiltinStats* GetBuiltinStats();
+
+// The table of the current thread while it is enabled, nullptr otherwise: the one branch calls
+// take when nothing is counted.
+extern thread_local BuiltinStats* counted_builtins;
+
+// A call of a function in progress while builtins are counted. Green threads keep chains of
+// their own, like call frames.
+class CountedCall;
+
+CountedCall* ExchangeCountedCall(CountedCall* call);
+
+// Invokes function like CalcExpression does, counting the call if function is a builtin. Every
+// call is timed, so that the builtins enclosing it are charged only their own time.
+Object* InvokeCounted(Function* function, Object* form, Scope* scope);
@@ -1,15 +1,144 @@
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <string>
+#include "../eval_server.h"
+#include "../perf_counters.h"
+#include "../process_pool.h"
 #include "../scheme.h"
+#include "../tracer.h"
+
+// Evaluates every input line in a pool of forked workers. Lines are dispatched as soon as they
+// are read and results are printed in input order; a terminal waits for each result.
+int RunWorkers(Interpreter* prototype, size_t workers) {
+    ProcessPool pool(prototype, workers);
+    bool interactive = isatty(STDIN_FILENO);
+    std::map<size_t, JobResult> done;
+    size_t next_output = 0;
+    size_t in_flight = 0;
+    auto print_ready = [&] {
+        for (auto it = done.find(next_output); it != done.end(); it = done.find(next_output)) {
+            std::cout << it->second.output << "\n\n";
+            done.erase(it);
+            ++next_output;
+        }
+    };
+    auto wait_one = [&] {
+        size_t id;
+        JobResult result;
+        if (pool.Next(&id, &result)) {
+            done.emplace(id, std::move(result));
+            --in_flight;
+        }
+        print_ready();
+    };
+
+    std::string s;
+    while (true) {
+        if (interactive) {
+            std::cout << ">> " << std::flush;
+        }
+        if (!std::getline(std::cin, s)) {
+            break;
+        }
+        pool.Submit(s);
+        ++in_flight;
+        while (in_flight > 0 && (interactive || in_flight >= pool.Size())) {
+            wait_one();
+        }
+    }
+    while (in_flight > 0) {
+        wait_one();
+    }
+    return 0;
+}
 
-int main() {
+// Serves sessions on a Unix socket until killed; every session starts from the image.
+int Listen(const std::string& path, const std::string& image) {
+    try {
+        EvalServer server(path, [&image](Interpreter* interpreter) {
+            if (!image.empty()) {
+                interpreter->LoadImage(image);
+            }
+        });
+        server.Serve();
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
     Interpreter i;
     std::string s;
+    size_t workers = 0;
+    std::string listen;
+    std::unique_ptr<Tracer> tracer;
+    bool perf = false;
+    int arg = 1;
+    while (arg < argc) {
+        if (std::strcmp(argv[arg], "--perf") == 0) {
+            perf = true;
+            ++arg;
+            continue;
+        }
+        if (arg + 1 == argc) {
+            break;
+        }
+        if (std::strcmp(argv[arg], "--workers") == 0) {
+            workers = std::strtoul(argv[arg + 1], nullptr, 10);
+        } else if (std::strcmp(argv[arg], "--listen") == 0) {
+            listen = argv[arg + 1];
+        } else if (std::strcmp(argv[arg], "--trace") == 0) {
+            try {
+                tracer = std::make_unique<Tracer>(argv[arg + 1]);
+            } catch (const std::runtime_error& e) {
+                std::cerr << e.what() << "\n";
+                return 1;
+            }
+        } else {
+            break;
+        }
+        arg += 2;
+    }
+    if (!listen.empty()) {
+        std::string image = arg < argc ? argv[arg] : "";
+        return Listen(listen, image);
+    }
+    // The local user may write files anyway; sessions of --listen never get dump-heap.
+    i.BindDumpHeap();
+    if (arg < argc) {
+        try {
+            i.LoadImage(argv[arg]);
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+    if (workers > 0) {
+        return RunWorkers(&i, workers);
+    }
     while (true) {
         try {
             std::cout << ">> ";
-            std::getline(std::cin, s);
-            std::cout << i.Run(s) << "\n\n";
+            if (!std::getline(std::cin, s)) {
+                break;
+            }
+            if (perf) {
+                // Reports go to stderr, out of the way of the results.
+                PerfCounters counters;
+                counters.Start();
+                auto result = i.Run(s);
+                std::cerr << FormatPerfReport(counters.Stop());
+                std::cout << result << "\n\n";
+            } else {
+                std::cout << i.Run(s) << "\n\n";
+            }
         } catch(const std::runtime_error& e) {
             std::cout << e.what() << "\n\n";
         } 
@@ -0,0 +1,108 @@
+#include "scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace {
+// Scheduler and worker index owning the current thread, if any.
+thread_local const Scheduler* current_scheduler = nullptr;
+thread_local size_t current_worker = 0;
+}  // namespace
+
+Scheduler::Scheduler(size_t workers) {
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); ++i) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < workers; ++i) {
+        workers_.emplace_back([this, i] { WorkerLoop(i); });
+    }
+}
+
+Scheduler::~Scheduler() {
+    HelpUntil([this] { return queued_ == 0; });
+    {
+        std::lock_guard lock(sleep_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void Scheduler::Spawn(Task task) {
+    size_t target = current_scheduler == this ? current_worker : next_queue_++ % queues_.size();
+    {
+        std::lock_guard lock(queues_[target]->mutex);
+        queues_[target]->tasks.push_back(std::move(task));
+    }
+    {
+        // Taking the lock orders the increment with a worker's check before it goes to sleep.
+        std::lock_guard lock(sleep_mutex_);
+        ++queued_;
+    }
+    wake_.notify_all();
+}
+
+void Scheduler::HelpUntil(const std::function<bool()>& done) {
+    size_t self = current_scheduler == this ? current_worker : next_queue_++ % queues_.size();
+    while (!done()) {
+        if (!TryRun(self)) {
+            std::unique_lock lock(sleep_mutex_);
+            wake_.wait_for(lock, std::chrono::microseconds(100),
+                           [this, &done] { return queued_ > 0 || done(); });
+        }
+    }
+}
+
+size_t Scheduler::Size() const {
+    return workers_.size();
+}
+
+bool Scheduler::TryRun(size_t self) {
+    Task task;
+    {
+        auto& own = *queues_[self];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+    for (size_t i = 1; !task && i < queues_.size(); ++i) {
+        auto& victim = *queues_[(self + i) % queues_.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    --queued_;
+    task();
+    // Tasks finishing may be what a helping thread is waiting for.
+    wake_.notify_all();
+    return true;
+}
+
+void Scheduler::WorkerLoop(size_t id) {
+    current_scheduler = this;
+    current_worker = id;
+    while (true) {
+        if (TryRun(id)) {
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+        if (stop_ && queued_ == 0) {
+            return;
+        }
+    }
+}
+
+Scheduler& GetScheduler() {
+    static Scheduler scheduler(std::thread::hardware_concurrency());
+    return scheduler;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing task scheduler. Every worker owns a deque: it pops its own tasks from the back
+// and steals from the front of the others when it runs dry. Tasks spawned by a worker go to its
+// own deque, tasks from other threads are spread over the workers round-robin.
+class Scheduler {
+public:
+    using Task = std::function<void()>;
+
+    Scheduler(size_t workers);
+
+    // Runs every task that is still queued before returning.
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    void Spawn(Task task);
+
+    // Runs queued tasks on the calling thread until done() holds, so a thread waiting for its
+    // own tasks never idles and nested waits can't exhaust the workers.
+    void HelpUntil(const std::function<bool()>& done);
+
+    size_t Size() const;
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool TryRun(size_t self);
+
+    void WorkerLoop(size_t id);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> next_queue_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stop_{false};
+    std::vector<std::thread> workers_;
+};
+
+// Process-wide scheduler with one worker per hardware thread.
+Scheduler& GetScheduler();
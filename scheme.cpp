@@ -3,11 +3,17 @@
 #include <vector>
 #include "error.h"
 #include "garbage_collector.h"
+#include "hash_table.h"
+#include "heap_dump.h"
+#include "image.h"
 #include "object.h"
 #include "parser.h"
+#include "snapshot.h"
 #include "tokenizer.h"
+#include "tracer.h"
 #include "functions.h"
 #include <cassert>
+#include <utility>
 
 std::vector<Object*> Convert(Object* ptr) {
     std::vector<Object*> ans;
@@ -21,15 +27,30 @@ std::vector<Object*> Convert(Object* ptr) {
     return ans;
 }
 
+std::string WithLocation(const std::string& message, Object* form) {
+    auto location = GetGC().GetLocation(form);
+    return location ? message + " at " + ToString(*location) : message;
+}
+
+// Kept out of CalcExpression, whose frame is repeated at every level of a deep recursion.
+[[noreturn]] void ThrowNotCallable(Object* form) {
+    throw RuntimeError(WithLocation("You can call only functions", form));
+}
+
 Object* CalcExpression(Object* object, Scope* scope) {
+    ChargeStep();
     if (object == nullptr) {
         throw RuntimeError("Lists Are Not Self Evaluating");
     }
     if (Is<Cell>(object)) {
         auto F = CalcExpression(As<Cell>(object)->GetFirst(), scope);
         if (!Is<Function>(F)) {
-            throw RuntimeError("You can call only functions");
+            ThrowNotCallable(object);
+        }
+        if (counted_builtins) {
+            return InvokeCounted(As<Function>(F), object, scope);
         }
+        CallFrame frame(As<Function>(F));
         return As<Function>(F)->Invoke(object, scope);
     } else {
         auto F = GetVariable(object, scope);
@@ -90,6 +111,18 @@ std::string GetString(Object* ptr) {
                 ans.back() = ')';
             }
         }
+    } else if (Is<Vector>(ptr)) {
+        ans = "#(";
+        for (auto el : As<Vector>(ptr)->GetElements()) {
+            ans += GetString(el) + " ";
+        }
+        if (ans.back() == ' ') {
+            ans.back() = ')';
+        } else {
+            ans += ')';
+        }
+    } else if (Is<HashTable>(ptr)) {
+        ans = "hash table";
     } else if (Is<Number>(ptr)) {
         ans = GetString(As<Number>(ptr));
     } else if (Is<Symbol>(ptr)) {
@@ -98,6 +131,12 @@ std::string GetString(Object* ptr) {
         ans = GetString(As<Bool>(ptr));
     } else if (Is<Lambda>(ptr)) {
         ans = "Lambda function";
+    } else if (Is<Future>(ptr)) {
+        ans = "future";
+    } else if (Is<GreenThread>(ptr)) {
+        ans = "green thread";
+    } else if (Is<Channel>(ptr) || Is<SharedChannel>(ptr)) {
+        ans = "channel";
     } else if (Is<Function>(ptr)) {
         ans = "built-in function";
     } else if (!ptr) {
@@ -106,71 +145,275 @@ std::string GetString(Object* ptr) {
     return ans;
 }
 
+constexpr size_t kDefaultParseCacheCapacity = 256;
+
 std::string Interpreter::Run(const std::string& expr) {
-    auto check_list = Read(expr);
-    if (check_list.size() != 1) {
-        throw RuntimeError("bad expression");
+    return Run(expr, Budget{});
+}
+
+std::string Interpreter::Run(const std::string& expr, const Budget& budget) {
+    auto start = std::chrono::steady_clock::now();
+    ActiveGC guard(&gc_);
+    ActiveGreenScheduler green_guard(&green_threads_);
+    BudgetGuard limits(budget);
+    ActiveProfiler profiling(profiler_.get());
+    ActiveBuiltinStats counting(&builtin_stats_);
+    std::string s_ans;
+    try {
+        auto check_list = parse_cache_.Read(expr);
+        if (check_list.size() != 1) {
+            throw RuntimeError("bad expression");
+        }
+        Object* ans;
+        {
+            TraceSpan span("eval", "Evaluate");
+            ans = CalcExpression(check_list[0], GetGlobalScope());
+        }
+        s_ans = GetString(ans);
+        // Green threads spawned so far run until they finish or wait on a channel.
+        green_threads_.RunReady();
+    } catch (...) {
+        // Everything the failed evaluation allocated is garbage now, so a heap that ran into
+        // its limit is usable again at once.
+        CollectGarbage();
+        ++failed_runs_;
+        RecordRun(start);
+        throw;
     }
-    auto ans = CalcExpression(check_list[0], GetGlobalScope());
-    std::string s_ans = GetString(ans);
-    GetGC().CleanUp();
+    CollectGarbage();
+    RecordRun(start);
     if (global_scope_ != GetGC().memory_[0].get()) {
         assert(false);
     }
     return s_ans;
 }
 
+void Interpreter::LoadImage(const std::string& path) {
+    ActiveGC guard(&gc_);
+    ActiveGreenScheduler green_guard(&green_threads_);
+    ActiveProfiler profiling(profiler_.get());
+    ActiveBuiltinStats counting(&builtin_stats_);
+    for (auto form : ReadImageFile(path)) {
+        TraceSpan span("eval", "Evaluate");
+        CalcExpression(form, GetGlobalScope());
+    }
+    green_threads_.RunReady();
+    CollectGarbage();
+}
+
+void Interpreter::SaveSnapshot(const std::string& path) {
+    ActiveGC guard(&gc_);
+    WriteSnapshotFile(global_scope_, path);
+}
+
+void Interpreter::DumpHeap(const std::string& path) {
+    ActiveGC guard(&gc_);
+    WriteHeapDumpFile(global_scope_, path);
+}
+
+void Interpreter::LoadSnapshot(const std::string& path) {
+    ActiveGC guard(&gc_);
+    global_scope_ = ReadSnapshotFile(path, base_->GetScope());
+    GetGC().SetRoot(global_scope_);
+    CollectGarbage();
+}
+
 Scope* Interpreter::GetGlobalScope() {
     return global_scope_;
 }
 
-Interpreter::Interpreter() {
-    GetGC().ClearAll();
-    global_scope_ = GetGC().New<Scope>();
+void Interpreter::BindDumpHeap() {
+    ActiveGC guard(&gc_);
+    global_scope_->Set("dump-heap", GetGC().New<DumpHeapFunction>());
+}
+
+void Interpreter::BindChannel(const std::string& name, std::shared_ptr<MessageChannel> channel) {
+    ActiveGC guard(&gc_);
+    auto handle = GetGC().New<SharedChannel>(std::move(channel));
+    global_scope_->Set(name, GetGC().New<Variable>(handle));
+}
+
+void Interpreter::SetMemoryLimit(size_t bytes) {
+    gc_.SetLimit(bytes);
+}
+
+size_t Interpreter::GetHeapSize() const {
+    return gc_.GetBytes();
+}
+
+HeapStats Interpreter::GetHeapStats() const {
+    return gc_.GetStats();
+}
+
+void Interpreter::ResetPeakHeapSize() {
+    gc_.ResetPeak();
+}
+
+RuntimeStats Interpreter::GetStats() const {
+    return {gc_.GetStats(), gc_.CountObjects(), runs_, failed_runs_, steps_, run_time_};
+}
+
+void Interpreter::RecordRun(std::chrono::steady_clock::time_point start) {
+    ++runs_;
+    steps_ += BudgetGuard::GetSteps();
+    run_time_.Record(std::chrono::steady_clock::now() - start);
+}
+
+void Interpreter::StartProfiling(std::chrono::microseconds interval) {
+    profiler_ = std::make_unique<SamplingProfiler>(interval);
+    profiler_->AddNames(global_scope_);
+}
+
+std::string Interpreter::StopProfiling() {
+    if (!profiler_) {
+        return "";
+    }
+    auto stacks = profiler_->GetFoldedStacks();
+    profiler_.reset();
+    return stacks;
+}
+
+void Interpreter::StartAllocationProfiling(size_t interval) {
+    allocation_profiler_ = std::make_unique<AllocationProfiler>(interval);
+    allocation_profiler_->AddNames(global_scope_);
+    gc_.SetAllocationProfiler(allocation_profiler_.get());
+}
+
+std::vector<AllocationSite> Interpreter::GetAllocationSites(size_t count) const {
+    if (!allocation_profiler_) {
+        return {};
+    }
+    return allocation_profiler_->GetTopSites(count);
+}
+
+std::string Interpreter::StopAllocationProfiling(size_t count) {
+    if (!allocation_profiler_) {
+        return "";
+    }
+    gc_.SetAllocationProfiler(nullptr);
+    auto report = allocation_profiler_->GetReport(count);
+    allocation_profiler_.reset();
+    return report;
+}
+
+void Interpreter::SetBuiltinStats(bool on) {
+    builtin_stats_.SetEnabled(on);
+}
+
+std::vector<BuiltinCounters> Interpreter::GetBuiltinStats() const {
+    return builtin_stats_.GetCounters();
+}
+
+void Interpreter::ResetBuiltinStats() {
+    builtin_stats_.Reset();
+}
+
+void Interpreter::CollectGarbage() {
+    GetGC().CleanUp(green_threads_.GetRoots());
+}
+
+void Interpreter::SetParseCacheCapacity(size_t capacity) {
+    parse_cache_.SetCapacity(capacity);
+}
+
+ParseCacheStats Interpreter::GetParseCacheStats() const {
+    return parse_cache_.GetStats();
+}
+
+Interpreter::Interpreter() : Interpreter(GetDefaultEnvironment()) {
+}
+
+Interpreter::Interpreter(std::shared_ptr<const SharedEnvironment> base)
+    : base_{std::move(base)}, parse_cache_{kDefaultParseCacheCapacity, &gc_} {
+    ActiveGC guard(&gc_);
+    global_scope_ = GetGC().New<Scope>(base_->GetScope());
+}
+
+void RegisterBuiltins(Scope* scope) {
     // Quotes
-    global_scope_->Set("'", GetGC().New<QuoteFunction>());
-    global_scope_->Set("quote", GetGC().New<QuoteFunction>());
+    scope->Set("'", GetGC().New<QuoteFunction>());
+    scope->Set("quote", GetGC().New<QuoteFunction>());
     // Numbers
-    global_scope_->Set("number?", GetGC().New<IsNumberFunction>());
-    global_scope_->Set("+", GetGC().New<SumFunction>());
-    global_scope_->Set("-", GetGC().New<SubtractFunction>());
-    global_scope_->Set("=", GetGC().New<EqualFunction>());
-    global_scope_->Set(">", GetGC().New<GreaterFunction>());
-    global_scope_->Set(">=", GetGC().New<GreaterOrEqualFunction>());
-    global_scope_->Set("<", GetGC().New<LessFunction>());
-    global_scope_->Set("<=", GetGC().New<LessOrEqualFunction>());
-    global_scope_->Set("*", GetGC().New<MultFunction>());
-    global_scope_->Set("/", GetGC().New<DivFunction>());
-    global_scope_->Set("max", GetGC().New<MaxFunction>());
-    global_scope_->Set("min", GetGC().New<MinFunction>());
-    global_scope_->Set("abs", GetGC().New<AbsFunction>());
+    scope->Set("number?", GetGC().New<IsNumberFunction>());
+    scope->Set("+", GetGC().New<SumFunction>());
+    scope->Set("-", GetGC().New<SubtractFunction>());
+    scope->Set("=", GetGC().New<EqualFunction>());
+    scope->Set(">", GetGC().New<GreaterFunction>());
+    scope->Set(">=", GetGC().New<GreaterOrEqualFunction>());
+    scope->Set("<", GetGC().New<LessFunction>());
+    scope->Set("<=", GetGC().New<LessOrEqualFunction>());
+    scope->Set("*", GetGC().New<MultFunction>());
+    scope->Set("/", GetGC().New<DivFunction>());
+    scope->Set("max", GetGC().New<MaxFunction>());
+    scope->Set("min", GetGC().New<MinFunction>());
+    scope->Set("abs", GetGC().New<AbsFunction>());
     // Bools
-    global_scope_->Set("#t", GetGC().New<Variable>(GetGC().New<Bool>(true)));
-    global_scope_->Set("#f", GetGC().New<Variable>(GetGC().New<Bool>(false)));
-    global_scope_->Set("boolean?", GetGC().New<IsBoolFunction>());
-    global_scope_->Set("not", GetGC().New<NotFunction>());
-    global_scope_->Set("and", GetGC().New<AndFunction>());
-    global_scope_->Set("or", GetGC().New<OrFunction>());
+    scope->Set("#t", GetGC().New<Variable>(GetGC().New<Bool>(true)));
+    scope->Set("#f", GetGC().New<Variable>(GetGC().New<Bool>(false)));
+    scope->Set("boolean?", GetGC().New<IsBoolFunction>());
+    scope->Set("not", GetGC().New<NotFunction>());
+    scope->Set("and", GetGC().New<AndFunction>());
+    scope->Set("or", GetGC().New<OrFunction>());
     // Lists
-    global_scope_->Set("pair?", GetGC().New<IsPairFunction>());
-    global_scope_->Set("null?", GetGC().New<IsNullFunction>());
-    global_scope_->Set("list?", GetGC().New<IsListFunction>());
-    global_scope_->Set("cons", GetGC().New<ConsFunction>());
-    global_scope_->Set("car", GetGC().New<CarFunction>());
-    global_scope_->Set("cdr", GetGC().New<CdrFunction>());
-    global_scope_->Set("list", GetGC().New<ListFunction>());
-    global_scope_->Set("list-ref", GetGC().New<ListRefFunction>());
-    global_scope_->Set("list-tail", GetGC().New<ListTailFunction>());
+    scope->Set("pair?", GetGC().New<IsPairFunction>());
+    scope->Set("null?", GetGC().New<IsNullFunction>());
+    scope->Set("list?", GetGC().New<IsListFunction>());
+    scope->Set("cons", GetGC().New<ConsFunction>());
+    scope->Set("car", GetGC().New<CarFunction>());
+    scope->Set("cdr", GetGC().New<CdrFunction>());
+    scope->Set("list", GetGC().New<ListFunction>());
+    scope->Set("list-ref", GetGC().New<ListRefFunction>());
+    scope->Set("list-tail", GetGC().New<ListTailFunction>());
+    // Vectors
+    scope->Set("vector?", GetGC().New<IsVectorFunction>());
+    scope->Set("vector", GetGC().New<VectorFunction>());
+    scope->Set("make-vector", GetGC().New<MakeVectorFunction>());
+    scope->Set("vector-length", GetGC().New<VectorLengthFunction>());
+    scope->Set("vector-ref", GetGC().New<VectorRefFunction>());
+    scope->Set("vector-set!", GetGC().New<VectorSetFunction>());
+    scope->Set("vector->list", GetGC().New<VectorToListFunction>());
+    scope->Set("list->vector", GetGC().New<ListToVectorFunction>());
+
+    // Hash tables
+    scope->Set("hash-table?", GetGC().New<IsHashTableFunction>());
+    scope->Set("make-hash-table", GetGC().New<MakeHashTableFunction>());
+    scope->Set("hash-table-ref", GetGC().New<HashTableRefFunction>());
+    scope->Set("hash-table-set!", GetGC().New<HashTableSetFunction>());
+    scope->Set("hash-table-delete!", GetGC().New<HashTableDeleteFunction>());
+    scope->Set("hash-table-contains?", GetGC().New<HashTableContainsFunction>());
+    scope->Set("hash-table-count", GetGC().New<HashTableCountFunction>());
+    scope->Set("hash-table->alist", GetGC().New<HashTableToAlistFunction>());
     // If
-    global_scope_->Set("if", GetGC().New<IfFunction>());
+    scope->Set("if", GetGC().New<IfFunction>());
     // Define
-    global_scope_->Set("symbol?", GetGC().New<IsSymbolFunction>());
-    global_scope_->Set("define", GetGC().New<DefineFunction>());
-    global_scope_->Set("set!", GetGC().New<SetFunction>());
-    global_scope_->Set("set-car!", GetGC().New<SetCarFunction>());
-    global_scope_->Set("set-cdr!", GetGC().New<SetCdrFunction>());
+    scope->Set("symbol?", GetGC().New<IsSymbolFunction>());
+    scope->Set("define", GetGC().New<DefineFunction>());
+    scope->Set("set!", GetGC().New<SetFunction>());
+    scope->Set("set-car!", GetGC().New<SetCarFunction>());
+    scope->Set("set-cdr!", GetGC().New<SetCdrFunction>());
+    // Parallel
+    scope->Set("pmap", GetGC().New<ParallelMapFunction>());
+    scope->Set("parallel-for-each", GetGC().New<ParallelForEachFunction>());
+    scope->Set("future", GetGC().New<FutureFunction>());
+    scope->Set("touch", GetGC().New<TouchFunction>());
+    // Green threads
+    scope->Set("spawn", GetGC().New<SpawnFunction>());
+    scope->Set("yield", GetGC().New<YieldFunction>());
+    scope->Set("make-channel", GetGC().New<MakeChannelFunction>());
+    scope->Set("channel-send", GetGC().New<ChannelSendFunction>());
+    scope->Set("channel-recv", GetGC().New<ChannelReceiveFunction>());
+    // Profiling
+    scope->Set("profile", GetGC().New<ProfileFunction>());
+    scope->Set("gc-stats", GetGC().New<GcStatsFunction>());
+    scope->Set("builtin-stats", GetGC().New<BuiltinStatsFunction>());
+    scope->Set("with-perf-counters", GetGC().New<WithPerfCountersFunction>());
 }
 
 Interpreter::~Interpreter() {
-    GetGC().ClearAll();
+    gc_.WaitForFutures();
+    ActiveGC guard(&gc_);
+    ActiveGreenScheduler green_guard(&green_threads_);
+    ActiveBuiltinStats counting(&builtin_stats_);
+    // Green threads waiting on a channel hold C++ objects on their stacks.
+    green_threads_.Cancel();
 }
\ No newline at end of file
@@ -1,25 +1,143 @@
 #pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "budget.h"
 #include "garbage_collector.h"
+#include "green_threads.h"
+#include "message_channel.h"
 #include "object.h"
+#include "parse_cache.h"
+#include "profiler.h"
 #include "scope.h"
+#include "shared_environment.h"
+#include "telemetry.h"
 
+struct RuntimeStats {
+    HeapStats heap;
+    // Live objects by type as of the last collection.
+    std::map<std::string, size_t> objects;
+    // Calls of Run, including those that failed.
+    uint64_t runs;
+    uint64_t failed_runs;
+    // Evaluation steps (calls of CalcExpression) taken by all runs.
+    uint64_t steps;
+    LatencyHistogram run_time;
+};
+
+// stats in the Prometheus text exposition format, every metric name starting with "scheme_".
+std::string FormatPrometheus(const RuntimeStats& stats);
+
+// Every interpreter owns its heap, so interpreters are independent of each other and may be
+// used from any thread, one thread at a time.
 class Interpreter {
 public:
+    // The global scope is private to the interpreter and layered over base, which is shared.
     Interpreter();
 
+    explicit Interpreter(std::shared_ptr<const SharedEnvironment> base);
+
     std::string Run(const std::string& expr);
 
+    // Throws ResourceExhausted once the evaluation exceeds budget; the interpreter stays usable.
+    std::string Run(const std::string& expr, const Budget& budget);
+
+    // Evaluates every form of an image written by WriteImage in the global scope.
+    void LoadImage(const std::string& path);
+
+    // Writes everything reachable from the global scope, e.g. after loading a prelude.
+    void SaveSnapshot(const std::string& path);
+
+    // Writes everything reachable from the global scope as a heap dump, for scheme-heap.
+    void DumpHeap(const std::string& path);
+
+    // Replaces the global environment with one written by SaveSnapshot.
+    void LoadSnapshot(const std::string& path);
+
     Scope* GetGlobalScope();
 
+    // Defines dump-heap, which writes a heap dump to any path the script names, so it is left out
+    // of the builtins of interpreters running untrusted code.
+    void BindDumpHeap();
+
+    // Defines name as a handle of channel, which channel-send and channel-recv accept. Binding
+    // one channel in several interpreters connects them; values are copied between the heaps.
+    void BindChannel(const std::string& name, std::shared_ptr<MessageChannel> channel);
+
+    // Bounds the number of distinct expressions whose parsed form Run keeps; 0 disables caching.
+    void SetParseCacheCapacity(size_t capacity);
+
+    ParseCacheStats GetParseCacheStats() const;
+
+    // Caps the bytes taken by the interpreter's heap; 0 removes the cap. An evaluation that
+    // would exceed it fails with ResourceExhausted and its garbage is collected right away.
+    // Futures and parallel maps may each use up to the cap in their own heaps.
+    void SetMemoryLimit(size_t bytes);
+
+    size_t GetHeapSize() const;
+
+    HeapStats GetHeapStats() const;
+
+    void ResetPeakHeapSize();
+
+    RuntimeStats GetStats() const;
+
+    // Samples the evaluations of Run and LoadImage until StopProfiling, on whichever thread
+    // they run. Work handed to futures and parallel maps is not sampled.
+    void StartProfiling(std::chrono::microseconds interval = std::chrono::milliseconds(1));
+
+    // Folded stacks of everything sampled since StartProfiling, for flamegraph tools.
+    std::string StopProfiling();
+
+    // Samples one in every interval allocations of the heap until StopAllocationProfiling.
+    // Survival rates are settled by the collection at the end of every Run.
+    void StartAllocationProfiling(size_t interval = 64);
+
+    // The count allocation sites that took the most bytes so far; empty when not profiling.
+    std::vector<AllocationSite> GetAllocationSites(size_t count) const;
+
+    // Report of the count top allocation sites since StartAllocationProfiling.
+    std::string StopAllocationProfiling(size_t count = 20);
+
+    // Switches counting the calls of builtins made by Run and LoadImage; off at first. Scheme
+    // code switches it with (builtin-stats #t) and reads the counters with (builtin-stats).
+    void SetBuiltinStats(bool on);
+
+    // Counters of the builtins called while counting was on, most self time first.
+    std::vector<BuiltinCounters> GetBuiltinStats() const;
+
+    void ResetBuiltinStats();
+
     ~Interpreter();
 
 private:
+    // Collects the heap unless green threads are suspended in the middle of an evaluation.
+    void CollectGarbage();
+
+    // Accounts a Run that started at start; called before its BudgetGuard is gone.
+    void RecordRun(std::chrono::steady_clock::time_point start);
+
+    std::shared_ptr<const SharedEnvironment> base_;
+    GarbageCollector gc_;
     Scope* global_scope_;
+    ParseCache parse_cache_;
+    GreenScheduler green_threads_;
+    std::unique_ptr<SamplingProfiler> profiler_;
+    std::unique_ptr<AllocationProfiler> allocation_profiler_;
+    BuiltinStats builtin_stats_;
+    uint64_t runs_{0};
+    uint64_t failed_runs_{0};
+    uint64_t steps_{0};
+    LatencyHistogram run_time_;
 };
 
+// Binds every builtin function in scope.
+void RegisterBuiltins(Scope* scope);
+
 bool CheckPair(Object* ptr);
 
 bool CheckList(Object* ptr);
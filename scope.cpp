@@ -1,32 +1,73 @@
 #include "scope.h"
 #include "error.h"
 #include "functions.h"
+#include "garbage_collector.h"
 #include "object.h"
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 
+namespace {
+constexpr size_t kScopeLockStripes = 64;
+std::shared_mutex scope_locks[kScopeLockStripes];
+
+std::shared_mutex* GetLock(const Scope* scope) {
+    // Threads evaluating for the same interpreter share the count of its heap, so scopes of other
+    // interpreters are not locked.
+    if (scope->frozen_ || !GetGC().IsEvaluatedConcurrently()) {
+        return nullptr;
+    }
+    return &scope_locks[(reinterpret_cast<uintptr_t>(scope) >> 4) % kScopeLockStripes];
+}
+
+std::shared_lock<std::shared_mutex> ReadLock(const Scope* scope) {
+    auto mutex = GetLock(scope);
+    return mutex ? std::shared_lock(*mutex) : std::shared_lock<std::shared_mutex>();
+}
+
+std::unique_lock<std::shared_mutex> WriteLock(const Scope* scope) {
+    auto mutex = GetLock(scope);
+    return mutex ? std::unique_lock(*mutex) : std::unique_lock<std::shared_mutex>();
+}
+}  // namespace
+
 Scope::Scope(Scope* sc) : par_scope_{sc} {
 }
 
 Object* Scope::Get(const std::string& name) {
-    if (mp_.find(name) == mp_.end()) {
+    auto lock = ReadLock(this);
+    auto it = mp_.find(name);
+    if (it == mp_.end()) {
         return nullptr;
     }
-    return mp_[name];
+    return it->second;
 }
 
 void Scope::Set(const std::string& name, Object* obj) {
-    mp_[name] = obj;
+    auto lock = WriteLock(this);
+    auto it = mp_.find(name);
+    if (it != mp_.end()) {
+        it->second = obj;
+        return;
+    }
+    auto buckets = mp_.bucket_count();
+    mp_.emplace(name, obj);
+    GetGC().Charge(BindingBytes(name) + (mp_.bucket_count() - buckets) * sizeof(void*));
 }
 
 bool Scope::TrySet(const std::string& name, Object* obj) {
-    if (mp_.find(name) == mp_.end()) {
+    auto lock = WriteLock(this);
+    auto it = mp_.find(name);
+    if (it == mp_.end()) {
         return false;
     }
-    mp_[name] = obj;
+    it->second = obj;
     return true;
 }
 
 bool Scope::TrySetCar(const std::string& name, Object* obj) {
+    auto lock = WriteLock(this);
     if (mp_.find(name) == mp_.end()) {
         return false;
     }
@@ -39,6 +80,7 @@ bool Scope::TrySetCar(const std::string& name, Object* obj) {
 }
 
 bool Scope::TrySetCdr(const std::string& name, Object* obj) {
+    auto lock = WriteLock(this);
     if (mp_.find(name) == mp_.end()) {
         return false;
     }
@@ -22,4 +22,6 @@ public:
 
     Scope* par_scope_;
     std::unordered_map<std::string, Object*> mp_;
-};
\ No newline at end of file
+    // Set on scopes of a SharedEnvironment, which are never modified again.
+    bool frozen_{false};
+};
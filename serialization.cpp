@@ -0,0 +1,108 @@
+#include "serialization.h"
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "error.h"
+
+void PutVarint(uint64_t value, std::string* out) {
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+void PutString(const std::string& value, std::string* out) {
+    PutVarint(value.size(), out);
+    out->append(value);
+}
+
+uint64_t ZigZag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t UnZigZag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+ByteReader::ByteReader(const char* data, size_t size) : pos_{data}, end_{data + size} {
+}
+
+uint8_t ByteReader::GetByte() {
+    if (pos_ == end_) {
+        throw RuntimeError("Truncated binary data");
+    }
+    return static_cast<uint8_t>(*pos_++);
+}
+
+uint64_t ByteReader::GetVarint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = GetByte();
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw RuntimeError("Bad varint in binary data");
+}
+
+size_t ByteReader::GetCount() {
+    uint64_t count = GetVarint();
+    if (count > static_cast<uint64_t>(end_ - pos_)) {
+        throw RuntimeError("Truncated binary data");
+    }
+    return count;
+}
+
+std::string ByteReader::GetString() {
+    size_t len = GetCount();
+    std::string ans(pos_, len);
+    pos_ += len;
+    return ans;
+}
+
+bool ByteReader::Expect(const char* prefix, size_t size) {
+    if (static_cast<size_t>(end_ - pos_) < size || std::memcmp(pos_, prefix, size) != 0) {
+        return false;
+    }
+    pos_ += size;
+    return true;
+}
+
+bool ByteReader::IsEnd() const {
+    return pos_ == end_;
+}
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw RuntimeError("Can't open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        throw RuntimeError("Empty or unreadable file " + path);
+    }
+    size_ = st.st_size;
+    data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data_ == MAP_FAILED) {
+        throw RuntimeError("Can't map " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    munmap(data_, size_);
+}
+
+const char* MappedFile::Data() const {
+    return static_cast<const char*>(data_);
+}
+
+size_t MappedFile::Size() const {
+    return size_;
+}
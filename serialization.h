@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Helpers shared by the binary formats (images, snapshots): LEB128 varints, zigzag encoding of
+// signed values and a bounds-checked reader. Malformed input raises RuntimeError.
+void PutVarint(uint64_t value, std::string* out);
+
+void PutString(const std::string& value, std::string* out);
+
+uint64_t ZigZag(int64_t value);
+
+int64_t UnZigZag(uint64_t value);
+
+class ByteReader {
+public:
+    ByteReader(const char* data, size_t size);
+
+    uint8_t GetByte();
+
+    uint64_t GetVarint();
+
+    // A count of items that follow; bounded by the remaining bytes, which keeps corrupted input
+    // from requesting huge allocations.
+    size_t GetCount();
+
+    std::string GetString();
+
+    // Compares the next bytes with the given prefix and skips them on success.
+    bool Expect(const char* prefix, size_t size);
+
+    bool IsEnd() const;
+
+private:
+    const char* pos_;
+    const char* end_;
+};
+
+// Read-only private mapping of a whole file.
+class MappedFile {
+public:
+    MappedFile(const std::string& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* Data() const;
+
+    size_t Size() const;
+
+private:
+    void* data_;
+    size_t size_;
+};
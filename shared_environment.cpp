@@ -0,0 +1,84 @@
+#include "shared_environment.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include "hash_table.h"
+#include "parser.h"
+#include "scheme.h"
+
+namespace {
+std::shared_mutex registry_mutex;
+std::vector<const SharedEnvironment*> registry;
+// Environments with pairs, vectors or hash tables; while there are none, IsShared takes no lock.
+std::atomic<size_t> registered{0};
+}  // namespace
+
+SharedEnvironment::SharedEnvironment(const std::string& prelude) {
+    ActiveGC guard(&gc_);
+    scope_ = GetGC().New<Scope>(nullptr);
+    RegisterBuiltins(scope_);
+    for (auto form : ReadAll(prelude)) {
+        CalcExpression(form, scope_);
+    }
+    gc_.WaitForFutures();
+    GetGC().CleanUp();
+
+    for (const auto& obj : gc_.memory_) {
+        objects_.insert(obj.get());
+        if (Is<Scope>(obj.get())) {
+            As<Scope>(obj.get())->frozen_ = true;
+        } else if (Is<Cell>(obj.get()) || Is<Vector>(obj.get()) ||
+                   Is<HashTable>(obj.get())) {
+            cells_.insert(obj.get());
+        }
+    }
+    std::unique_lock lock(registry_mutex);
+    registry.push_back(this);
+    if (!cells_.empty()) {
+        ++registered;
+    }
+}
+
+SharedEnvironment::~SharedEnvironment() {
+    std::unique_lock lock(registry_mutex);
+    registry.erase(std::find(registry.begin(), registry.end(), this));
+    if (!cells_.empty()) {
+        --registered;
+    }
+}
+
+Scope* SharedEnvironment::GetScope() const {
+    return scope_;
+}
+
+bool SharedEnvironment::IsShared(const Object* obj) {
+    if (registered == 0) {
+        return false;
+    }
+    std::shared_lock lock(registry_mutex);
+    for (auto environment : registry) {
+        if (environment->cells_.count(obj)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SharedEnvironment::Owns(const Object* obj) {
+    std::shared_lock lock(registry_mutex);
+    for (auto environment : registry) {
+        if (environment->objects_.count(obj)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<const SharedEnvironment> GetDefaultEnvironment() {
+    static const auto environment = std::make_shared<const SharedEnvironment>();
+    return environment;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+#include "garbage_collector.h"
+#include "scope.h"
+
+// Builtins plus prelude definitions, evaluated once and then frozen, so that any number of
+// interpreters on any threads can share them as the parent of their private global scopes.
+// Frozen scopes are read without locks and skipped by the collectors of the interpreters;
+// set! of a shared binding is a RuntimeError; define can still shadow it in an interpreter's
+// global scope.
+class SharedEnvironment {
+public:
+    // Evaluates the prelude forms in a scope holding the builtins.
+    explicit SharedEnvironment(const std::string& prelude = "");
+
+    ~SharedEnvironment();
+
+    SharedEnvironment(const SharedEnvironment&) = delete;
+
+    SharedEnvironment& operator=(const SharedEnvironment&) = delete;
+
+    Scope* GetScope() const;
+
+    // Whether obj is a pair, a vector or a hash table owned by a live environment; such data must
+    // not be mutated.
+    static bool IsShared(const Object* obj);
+
+    // Whether obj is any object of a live environment, e.g. one of its builtins or frozen scopes.
+    static bool Owns(const Object* obj);
+
+private:
+    GarbageCollector gc_;
+    Scope* scope_;
+    std::unordered_set<const Object*> cells_;
+    std::unordered_set<const Object*> objects_;
+};
+
+// Environment holding only the builtins, created on first use.
+std::shared_ptr<const SharedEnvironment> GetDefaultEnvironment();
@@ -0,0 +1,313 @@
+#include "snapshot.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+#include "error.h"
+#include "functions.h"
+#include "garbage_collector.h"
+#include "hash_table.h"
+#include "object.h"
+#include "scope.h"
+#include "serialization.h"
+
+constexpr char kSnapshotMagic[4] = {'S', 'C', 'M', 'S'};
+constexpr uint64_t kSnapshotVersion = 5;
+
+enum SnapshotTag : uint8_t {
+    kTagNumber = 0,
+    kTagBool = 1,
+    kTagSymbol = 2,
+    kTagCell = 3,
+    kTagScope = 4,
+    kTagVariable = 5,
+    kTagLambda = 6,
+    kTagLambdaGenerator = 7,
+    kTagBuiltin = 8,
+    kTagSharedScope = 9,
+    kTagVector = 10,
+    kTagHashTable = 11,
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Writer
+
+class SnapshotWriter {
+public:
+    void Write(Scope* root, std::string* out) {
+        GetId(root);
+        for (size_t i = 0; i < order_.size(); ++i) {
+            WriteRecord(order_[i]);
+        }
+        out->append(kSnapshotMagic, sizeof(kSnapshotMagic));
+        PutVarint(kSnapshotVersion, out);
+        PutVarint(order_.size(), out);
+        out->append(records_);
+    }
+
+private:
+    // Objects seen for the first time are queued for writing.
+    size_t GetId(Object* obj) {
+        auto it = ids_.find(obj);
+        if (it == ids_.end()) {
+            it = ids_.emplace(obj, order_.size()).first;
+            order_.push_back(obj);
+        }
+        return it->second;
+    }
+
+    // Writes the index of the object plus one, 0 stands for nullptr.
+    void Ref(Object* obj) {
+        PutVarint(obj ? GetId(obj) + 1 : 0, &records_);
+    }
+
+    void WriteRecord(Object* obj) {
+        if (Is<Number>(obj)) {
+            records_.push_back(kTagNumber);
+            PutVarint(ZigZag(As<Number>(obj)->GetValue()), &records_);
+        } else if (Is<Bool>(obj)) {
+            records_.push_back(kTagBool);
+            records_.push_back(As<Bool>(obj)->GetValue());
+        } else if (Is<Symbol>(obj)) {
+            records_.push_back(kTagSymbol);
+            PutString(As<Symbol>(obj)->GetName(), &records_);
+        } else if (Is<Cell>(obj)) {
+            records_.push_back(kTagCell);
+            Ref(As<Cell>(obj)->GetFirst());
+            Ref(As<Cell>(obj)->GetSecond());
+        } else if (Is<Vector>(obj)) {
+            records_.push_back(kTagVector);
+            PutVarint(As<Vector>(obj)->GetElements().size(), &records_);
+            for (auto el : As<Vector>(obj)->GetElements()) {
+                Ref(el);
+            }
+        } else if (Is<HashTable>(obj)) {
+            records_.push_back(kTagHashTable);
+            PutVarint(As<HashTable>(obj)->Size(), &records_);
+            As<HashTable>(obj)->ForEach([&](Object* key, Object* value) {
+                Ref(key);
+                Ref(value);
+            });
+        } else if (Is<Scope>(obj) && As<Scope>(obj)->frozen_) {
+            records_.push_back(kTagSharedScope);
+        } else if (Is<Scope>(obj)) {
+            auto scope = As<Scope>(obj);
+            records_.push_back(kTagScope);
+            Ref(scope->par_scope_);
+            PutVarint(scope->mp_.size(), &records_);
+            for (const auto& [name, value] : scope->mp_) {
+                PutString(name, &records_);
+                Ref(value);
+            }
+        } else if (Is<Variable>(obj)) {
+            records_.push_back(kTagVariable);
+            Ref(As<Variable>(obj)->var_);
+        } else if (Is<Lambda>(obj)) {
+            auto lambda = As<Lambda>(obj);
+            records_.push_back(kTagLambda);
+            Ref(lambda->par_scope_);
+            PutVarint(lambda->params_.size(), &records_);
+            for (auto el : lambda->params_) {
+                Ref(el);
+            }
+            PutVarint(lambda->actions_.size(), &records_);
+            for (auto el : lambda->actions_) {
+                Ref(el);
+            }
+            Ref(lambda->name_);
+        } else if (Is<LambdaGenerator>(obj)) {
+            records_.push_back(kTagLambdaGenerator);
+            Ref(As<LambdaGenerator>(obj)->scope_);
+        } else if (IsBuiltin(obj)) {
+            records_.push_back(kTagBuiltin);
+            PutString(typeid(*obj).name(), &records_);
+        } else {
+            throw RuntimeError("Object of unknown type can't be written to a snapshot");
+        }
+    }
+
+    std::string records_;
+    std::vector<Object*> order_;
+    std::unordered_map<Object*, size_t> ids_;
+};
+
+void WriteSnapshot(Scope* root, std::string* out) {
+    SnapshotWriter writer;
+    writer.Write(root, out);
+}
+
+void WriteSnapshotFile(Scope* root, const std::string& path) {
+    std::string data;
+    WriteSnapshot(root, &data);
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), data.size());
+    if (!out) {
+        throw RuntimeError("Can't write snapshot " + path);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// Reader
+
+class SnapshotReader {
+public:
+    SnapshotReader(const char* data, size_t size, Scope* base) : in_{data, size}, base_{base} {
+        for (auto scope = base; scope; scope = scope->par_scope_) {
+            for (const auto& el : scope->mp_) {
+                if (IsBuiltin(el.second)) {
+                    builtins_.emplace(typeid(*el.second).name(), As<Function>(el.second));
+                }
+            }
+        }
+    }
+
+    Scope* Read() {
+        if (!in_.Expect(kSnapshotMagic, sizeof(kSnapshotMagic))) {
+            throw RuntimeError("Bad snapshot header");
+        }
+        if (in_.GetVarint() != kSnapshotVersion) {
+            throw RuntimeError("Unsupported snapshot version");
+        }
+        objects_.resize(in_.GetCount());
+        for (auto& obj : objects_) {
+            obj = ReadRecord();
+        }
+        if (!in_.IsEnd()) {
+            throw RuntimeError("Trailing data in snapshot");
+        }
+        // Relocation: every reference is resolved only once all objects exist.
+        for (const auto& [slot, id] : fixups_) {
+            *slot = Resolve(id);
+        }
+        for (const auto& [slot, id] : scope_fixups_) {
+            auto obj = Resolve(id);
+            if (obj && !Is<Scope>(obj)) {
+                throw RuntimeError("Bad scope reference in snapshot");
+            }
+            *slot = As<Scope>(obj);
+        }
+        // Keys are hashed by their contents, which only exist once the references are resolved.
+        for (const auto& [table, key, value] : entries_) {
+            table->Set(Resolve(key), Resolve(value));
+        }
+        if (objects_.empty() || !Is<Scope>(objects_[0])) {
+            throw RuntimeError("Snapshot root is not a scope");
+        }
+        return As<Scope>(objects_[0]);
+    }
+
+private:
+    Object* ReadRecord() {
+        switch (in_.GetByte()) {
+            case kTagNumber:
+                return GetGC().New<Number>(UnZigZag(in_.GetVarint()));
+            case kTagBool:
+                return GetGC().New<Bool>(in_.GetByte() != 0);
+            case kTagSymbol:
+                return GetGC().New<Symbol>(in_.GetString());
+            case kTagCell: {
+                auto cell = GetGC().New<Cell>();
+                Fix(&cell->GetFirst());
+                Fix(&cell->GetSecond());
+                return cell;
+            }
+            case kTagVector: {
+                auto vector = NewVector(in_.GetCount());
+                for (auto& el : vector->GetElements()) {
+                    Fix(&el);
+                }
+                return vector;
+            }
+            case kTagHashTable: {
+                auto table = GetGC().New<HashTable>();
+                size_t size = in_.GetCount();
+                for (size_t i = 0; i < size; ++i) {
+                    auto key = in_.GetVarint();
+                    entries_.emplace_back(table, key, in_.GetVarint());
+                }
+                return table;
+            }
+            case kTagScope: {
+                auto scope = GetGC().New<Scope>(nullptr);
+                scope_fixups_.emplace_back(&scope->par_scope_, in_.GetVarint());
+                size_t size = in_.GetCount();
+                for (size_t i = 0; i < size; ++i) {
+                    auto name = in_.GetString();
+                    Fix(&scope->mp_[name]);
+                }
+                return scope;
+            }
+            case kTagVariable: {
+                auto variable = GetGC().New<Variable>(nullptr);
+                Fix(&variable->var_);
+                return variable;
+            }
+            case kTagLambda: {
+                auto lambda = GetGC().New<Lambda>(nullptr, std::vector<Object*>{},
+                                                  std::vector<Object*>{});
+                scope_fixups_.emplace_back(&lambda->par_scope_, in_.GetVarint());
+                lambda->params_.resize(in_.GetCount());
+                for (auto& el : lambda->params_) {
+                    Fix(&el);
+                }
+                lambda->actions_.resize(in_.GetCount());
+                for (auto& el : lambda->actions_) {
+                    Fix(&el);
+                }
+                Fix(&lambda->name_);
+                return lambda;
+            }
+            case kTagLambdaGenerator: {
+                auto generator = GetGC().New<LambdaGenerator>(nullptr);
+                scope_fixups_.emplace_back(&generator->scope_, in_.GetVarint());
+                return generator;
+            }
+            case kTagSharedScope:
+                return base_;
+            case kTagBuiltin: {
+                auto it = builtins_.find(in_.GetString());
+                if (it == builtins_.end()) {
+                    throw RuntimeError("Snapshot refers to an unknown builtin");
+                }
+                return it->second;
+            }
+            default:
+                throw RuntimeError("Unknown record in snapshot");
+        }
+    }
+
+    void Fix(Object** slot) {
+        fixups_.emplace_back(slot, in_.GetVarint());
+    }
+
+    Object* Resolve(uint64_t id) {
+        if (id == 0) {
+            return nullptr;
+        }
+        if (id > objects_.size()) {
+            throw RuntimeError("Bad reference in snapshot");
+        }
+        return objects_[id - 1];
+    }
+
+    ByteReader in_;
+    Scope* base_;
+    std::unordered_map<std::string, Function*> builtins_;
+    std::vector<Object*> objects_;
+    std::vector<std::pair<Object**, uint64_t>> fixups_;
+    std::vector<std::pair<Scope**, uint64_t>> scope_fixups_;
+    std::vector<std::tuple<HashTable*, uint64_t, uint64_t>> entries_;
+};
+
+Scope* ReadSnapshot(const char* data, size_t size, Scope* base) {
+    SnapshotReader reader(data, size, base);
+    return reader.Read();
+}
+
+Scope* ReadSnapshotFile(const std::string& path, Scope* base) {
+    MappedFile file(path);
+    return ReadSnapshot(file.Data(), file.Size(), base);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+#include "scope.h"
+
+// Snapshot of the heap reachable from a global scope. Objects are stored as records that refer
+// to each other by index; loading allocates them in the current garbage collector and relocates
+// the references. Builtin functions are stored by their type and rebound to the builtins found in
+// the scope passed to the reader, so a snapshot is only valid for the binary that wrote it.
+// Frozen scopes of a SharedEnvironment are not stored; references to them are bound to the
+// scope passed to the reader.
+void WriteSnapshot(Scope* root, std::string* out);
+
+void WriteSnapshotFile(Scope* root, const std::string& path);
+
+Scope* ReadSnapshot(const char* data, size_t size, Scope* base);
+
+Scope* ReadSnapshotFile(const std::string& path, Scope* base);
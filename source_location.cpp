@@ -0,0 +1,41 @@
+#include "source_location.h"
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace {
+struct SourceFiles {
+    std::mutex mutex;
+    std::deque<std::string> names{"<input>"};
+    std::unordered_map<std::string, uint32_t> ids;
+};
+
+SourceFiles& GetSourceFiles() {
+    static SourceFiles files;
+    return files;
+}
+}  // namespace
+
+uint32_t InternSourceFile(const std::string& name) {
+    auto& files = GetSourceFiles();
+    std::lock_guard lock(files.mutex);
+    auto it = files.ids.find(name);
+    if (it != files.ids.end()) {
+        return it->second;
+    }
+    files.names.push_back(name);
+    files.ids.emplace(name, files.names.size() - 1);
+    return files.names.size() - 1;
+}
+
+const std::string& GetSourceFile(uint32_t id) {
+    auto& files = GetSourceFiles();
+    std::lock_guard lock(files.mutex);
+    return id < files.names.size() ? files.names[id] : files.names[0];
+}
+
+std::string ToString(const SourceLocation& location) {
+    return GetSourceFile(location.file) + ":" + std::to_string(location.line) + ":" +
+           std::to_string(location.column);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Position of a parsed form in its source. Files are interned process-wide and referred to by
+// id, which keeps a location at 12 bytes. Locations live in a side table of the garbage
+// collector (see GarbageCollector::SetLocation) rather than in the objects themselves.
+struct SourceLocation {
+    uint32_t file{0};
+    uint32_t line{1};
+    uint32_t column{1};
+};
+
+// Id 0 is reserved for sources without a name.
+uint32_t InternSourceFile(const std::string& name);
+
+const std::string& GetSourceFile(uint32_t id);
+
+// "file:line:column".
+std::string ToString(const SourceLocation& location);
@@ -0,0 +1,105 @@
+#include "telemetry.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "scheme.h"
+
+void LatencyHistogram::Record(std::chrono::nanoseconds duration) {
+    auto seconds = std::chrono::duration<double>(duration).count();
+    auto bucket = std::lower_bound(kBounds.begin(), kBounds.end(), seconds) - kBounds.begin();
+    ++counts_[bucket];
+    ++count_;
+    sum_ += duration;
+}
+
+const std::array<uint64_t, LatencyHistogram::kBounds.size() + 1>& LatencyHistogram::GetCounts()
+    const {
+    return counts_;
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+    return count_;
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetSum() const {
+    return sum_;
+}
+
+namespace {
+// Backslashes, double quotes and line feeds are the characters a label value must escape.
+std::string EscapeLabel(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void AddHeader(const std::string& name, const char* type, const char* help, std::string* out) {
+    *out += "# HELP " + name + " " + help + "\n";
+    *out += "# TYPE " + name + " " + type + "\n";
+}
+
+void AddValue(const std::string& name, const char* type, const char* help, uint64_t value,
+              std::string* out) {
+    AddHeader(name, type, help, out);
+    *out += name + " " + std::to_string(value) + "\n";
+}
+
+void AddHistogram(const std::string& name, const char* help, const LatencyHistogram& histogram,
+                  std::string* out) {
+    AddHeader(name, "histogram", help, out);
+    char line[128];
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < LatencyHistogram::kBounds.size(); ++i) {
+        cumulative += histogram.GetCounts()[i];
+        std::snprintf(line, sizeof(line), "%s_bucket{le=\"%g\"} %llu\n", name.c_str(),
+                      LatencyHistogram::kBounds[i], static_cast<unsigned long long>(cumulative));
+        *out += line;
+    }
+    *out += name + "_bucket{le=\"+Inf\"} " + std::to_string(histogram.GetCount()) + "\n";
+    std::snprintf(line, sizeof(line), "%s_sum %.9f\n", name.c_str(),
+                  std::chrono::duration<double>(histogram.GetSum()).count());
+    *out += line;
+    *out += name + "_count " + std::to_string(histogram.GetCount()) + "\n";
+}
+}  // namespace
+
+std::string FormatPrometheus(const RuntimeStats& stats) {
+    std::string out;
+    AddValue("scheme_heap_bytes", "gauge", "Bytes taken by the heap.", stats.heap.bytes, &out);
+    AddValue("scheme_heap_peak_bytes", "gauge", "High-water mark of the heap size.",
+             stats.heap.peak_bytes, &out);
+    AddValue("scheme_heap_allocated_bytes_total", "counter", "Bytes allocated on the heap.",
+             stats.heap.bytes_allocated, &out);
+    AddValue("scheme_heap_allocations_total", "counter", "Objects allocated on the heap.",
+             stats.heap.allocations, &out);
+    AddHeader("scheme_heap_objects", "gauge", "Live objects by type.", &out);
+    for (const auto& [type, count] : stats.objects) {
+        out += "scheme_heap_objects{type=\"" + EscapeLabel(type) + "\"} " + std::to_string(count) +
+               "\n";
+    }
+    AddValue("scheme_gc_collections_total", "counter", "Garbage collections.",
+             stats.heap.collections, &out);
+    AddHistogram("scheme_gc_mark_seconds", "Time spent marking live objects.",
+                 stats.heap.mark_time, &out);
+    AddHistogram("scheme_gc_sweep_seconds", "Time spent freeing garbage.", stats.heap.sweep_time,
+                 &out);
+    AddValue("scheme_runs_total", "counter", "Calls of Run.", stats.runs, &out);
+    AddValue("scheme_run_failures_total", "counter", "Calls of Run that threw.",
+             stats.failed_runs, &out);
+    AddValue("scheme_eval_steps_total", "counter", "Evaluation steps taken by Run.", stats.steps,
+             &out);
+    AddHistogram("scheme_run_seconds", "Latency of Run, collection included.", stats.run_time,
+                 &out);
+    return out;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Distribution of durations over fixed buckets from 10us to 10s, the layout of a Prometheus
+// histogram. Fixed buckets keep it allocation-free, so every heap can afford a few.
+class LatencyHistogram {
+public:
+    // Upper bounds of the buckets in seconds; durations above the last go to an extra one.
+    static constexpr std::array<double, 19> kBounds = {
+        1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3, 1e-2,
+        2.5e-2, 5e-2, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0};
+
+    void Record(std::chrono::nanoseconds duration);
+
+    // Durations in each bucket, not cumulative; the last entry is the overflow bucket.
+    const std::array<uint64_t, kBounds.size() + 1>& GetCounts() const;
+
+    uint64_t GetCount() const;
+
+    std::chrono::nanoseconds GetSum() const;
+
+private:
+    std::array<uint64_t, kBounds.size() + 1> counts_{};
+    uint64_t count_{0};
+    std::chrono::nanoseconds sum_{0};
+};
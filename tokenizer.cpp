@@ -22,6 +22,10 @@ Tokenizer::Tokenizer(std::istream* in) : in_{in} {
     SkipWhitespaces();
 }
 
+Tokenizer::Tokenizer(std::istream* in, SourceLocation start) : in_{in}, position_{start} {
+    SkipWhitespaces();
+}
+
 Token Tokenizer::GetToken() {
     if (!ready_) {
         Next();
@@ -29,6 +33,13 @@ Token Tokenizer::GetToken() {
     return parsed_token_;
 }
 
+SourceLocation Tokenizer::GetLocation() {
+    if (!ready_) {
+        Next();
+    }
+    return token_location_;
+}
+
 bool Tokenizer::IsEnd() {
     return in_->eof() && (!ready_);
 }
@@ -40,24 +51,25 @@ void Tokenizer::Next() {
         return;
     }
     ready_ = true;
+    token_location_ = position_;
     if (in_->peek() == '(') {
         parsed_token_ = BracketToken::OPEN;
-        in_->get();
+        Get();
     } else if (in_->peek() == ')') {
         parsed_token_ = BracketToken::CLOSE;
-        in_->get();
+        Get();
     } else if (in_->peek() == '.') {
         parsed_token_ = DotToken{};
-        in_->get();
+        Get();
     } else if (in_->peek() == '\'') {
         parsed_token_ = QuoteToken{};
-        in_->get();
+        Get();
     } else if (IsPM(in_->peek())) {
         std::string s;
-        s.push_back(in_->get());
+        s.push_back(Get());
         if (IsDigit(in_->peek())) {
             while (!in_->eof() && IsDigit(in_->peek())) {
-                s.push_back(in_->get());
+                s.push_back(Get());
             }
             parsed_token_ = ConstantToken{std::stoi(s)};
         } else {
@@ -65,16 +77,21 @@ void Tokenizer::Next() {
         }
     } else if (IsDigit(in_->peek())) {
         std::string s;
-        s.push_back(in_->get());
+        s.push_back(Get());
         while (!in_->eof() && IsDigit(in_->peek())) {
-            s.push_back(in_->get());
+            s.push_back(Get());
         }
         parsed_token_ = ConstantToken{std::stoi(s)};
     } else if (IsStart(in_->peek())) {
         std::string s;
-        s.push_back(in_->get());
+        s.push_back(Get());
+        if (s == "#" && in_->peek() == '(') {
+            Get();
+            parsed_token_ = VectorToken{};
+            return;
+        }
         while (!in_->eof() && IsInner(in_->peek())) {
-            s.push_back(in_->get());
+            s.push_back(Get());
         }
         parsed_token_ = SymbolToken{s};
     }
@@ -83,6 +100,17 @@ void Tokenizer::Next() {
     }
 }
 
+char Tokenizer::Get() {
+    char c = in_->get();
+    if (c == '\n') {
+        ++position_.line;
+        position_.column = 1;
+    } else {
+        ++position_.column;
+    }
+    return c;
+}
+
 bool Tokenizer::IsStart(char c) {
     // a-zA-Z<=>*#
     return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '<' || c == '=' || c == '>' ||
@@ -105,7 +133,7 @@ bool Tokenizer::IsPM(char c) {
 
 bool Tokenizer::GoodSymbol(char c) {
     return c == '(' || c == ')' || c == '.' || c == '\'' || IsPM(c) || IsDigit(c) || IsStart(c) ||
-           IsInner(c) || std::isspace(c) || c == -1;
+           IsInner(c) || std::isspace(static_cast<unsigned char>(c)) || c == -1;
 }
 
 void Tokenizer::SkipWhitespaces() {
@@ -113,6 +141,6 @@ void Tokenizer::SkipWhitespaces() {
         if (!in_->eof() && !GoodSymbol(in_->peek())) {
             throw SyntaxError("bad symbol");
         }
-        in_->get();
+        Get();
     }
 }
@@ -4,6 +4,8 @@
 #include <string>
 #include <iostream>
 
+#include "source_location.h"
+
 struct SymbolToken {
     std::string name;
 
@@ -24,6 +26,13 @@ struct DotToken {
     }
 };
 
+// "#(", which opens a vector literal.
+struct VectorToken {
+    bool operator==(const VectorToken&) const {
+        return true;
+    }
+};
+
 enum class BracketToken { OPEN, CLOSE };
 
 struct ConstantToken {
@@ -34,7 +43,8 @@ struct ConstantToken {
     }
 };
 
-using Token = std::variant<ConstantToken, BracketToken, SymbolToken, QuoteToken, DotToken>;
+using Token =
+    std::variant<ConstantToken, BracketToken, SymbolToken, QuoteToken, DotToken, VectorToken>;
 
 bool CheckCloseBracketToken(const Token& a);
 
@@ -46,8 +56,14 @@ class Tokenizer {
 public:
     Tokenizer(std::istream* in);
 
+    // start is the position of the first character of the stream.
+    Tokenizer(std::istream* in, SourceLocation start);
+
     Token GetToken();
 
+    // Position of the first character of the current token.
+    SourceLocation GetLocation();
+
     bool IsEnd();
 
     void Next();
@@ -56,6 +72,10 @@ private:
     bool ready_{false};
     Token parsed_token_;
     std::istream* in_;
+    SourceLocation position_;
+    SourceLocation token_location_;
+
+    char Get();
 
     bool IsStart(char c);
 
@@ -66,6 +66,28 @@ TEST_CASE("Symbol names") {
     REQUIRE(tokenizer.GetToken() == Token{SymbolToken{"zog-zog?"}});
 }
 
+TEST_CASE("Vector literals") {
+    std::stringstream ss{"#(1 #t) #"};
+    Tokenizer tokenizer{&ss};
+
+    REQUIRE(tokenizer.GetToken() == Token{VectorToken{}});
+
+    tokenizer.Next();
+    REQUIRE(tokenizer.GetToken() == Token{ConstantToken{1}});
+
+    tokenizer.Next();
+    REQUIRE(tokenizer.GetToken() == Token{SymbolToken{"#t"}});
+
+    tokenizer.Next();
+    REQUIRE(tokenizer.GetToken() == Token{BracketToken::CLOSE});
+
+    tokenizer.Next();
+    REQUIRE(tokenizer.GetToken() == Token{SymbolToken{"#"}});
+
+    tokenizer.Next();
+    REQUIRE(tokenizer.IsEnd());
+}
+
 TEST_CASE("GetToken is not moving") {
     std::stringstream ss{"1234+4"};
     Tokenizer tokenizer{&ss};
@@ -112,6 +134,14 @@ TEST_CASE("Spaces are handled correctly") {
         tokenizer.Next();
         REQUIRE(tokenizer.IsEnd());
     }
+
+    SECTION("Bytes outside of ASCII are not spaces") {
+        // A non-breaking space in Latin-1; negative as a plain char on most platforms.
+        std::stringstream ss{"4\xa0"};
+        Tokenizer tokenizer{&ss};
+
+        REQUIRE_THROWS_AS(tokenizer.GetToken(), SyntaxError);
+    }
 }
 
 TEST_CASE("Literal strings are handled correctly") {
@@ -0,0 +1,175 @@
+#include "tracer.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "error.h"
+#include "object.h"
+
+namespace {
+std::atomic<uint64_t> next_session{1};
+
+// Buffer of the current thread and the tracer session it belongs to.
+thread_local uint64_t buffer_session = 0;
+thread_local std::shared_ptr<TraceBuffer> thread_buffer;
+
+uint32_t GetThreadId() {
+    static thread_local uint32_t tid = static_cast<uint32_t>(syscall(SYS_gettid));
+    return tid;
+}
+
+void AppendEscaped(const char* s, std::string* out) {
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            *out += '\\';
+            *out += *s;
+        } else if (static_cast<unsigned char>(*s) < 0x20) {
+            *out += ' ';
+        } else {
+            *out += *s;
+        }
+    }
+}
+}  // namespace
+
+TraceBuffer::TraceBuffer(size_t capacity, uint32_t tid) : tid_{tid} {
+    size_t size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+    events_.resize(size);
+    mask_ = size - 1;
+}
+
+bool TraceBuffer::Push(const TraceEvent& event) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == events_.size()) {
+        return false;
+    }
+    events_[head & mask_] = event;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+uint32_t TraceBuffer::GetThreadId() const {
+    return tid_;
+}
+
+std::atomic<Tracer*> Tracer::active{nullptr};
+std::atomic<bool> Tracer::claimed{false};
+
+Tracer::Tracer(const std::string& path, const TraceOptions& options)
+    : options_{options},
+      session_{next_session++},
+      origin_{std::chrono::steady_clock::now()} {
+    bool expected = false;
+    if (!claimed.compare_exchange_strong(expected, true)) {
+        throw RuntimeError("Another tracer is already active");
+    }
+    out_.open(path);
+    if (!out_) {
+        claimed = false;
+        throw RuntimeError("Can't open trace file " + path);
+    }
+    out_ << "{\"traceEvents\":[";
+    writer_ = std::thread([this] { FlushLoop(); });
+    active = this;
+}
+
+Tracer::~Tracer() {
+    active = nullptr;
+    {
+        std::lock_guard lock(flush_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+    Flush();
+    out_ << "\n]}\n";
+    out_.close();
+    claimed = false;
+}
+
+void Tracer::Add(const char* category, std::string_view name,
+                 std::chrono::steady_clock::time_point start,
+                 std::chrono::steady_clock::time_point end) {
+    TraceEvent event;
+    event.category = category;
+    auto size = std::min(name.size(), sizeof(event.name) - 1);
+    std::memcpy(event.name, name.data(), size);
+    event.name[size] = '\0';
+    event.start_ns = (start - origin_).count();
+    event.duration_ns = (end - start).count();
+    if (!GetBuffer()->Push(event)) {
+        ++dropped_;
+    }
+}
+
+std::chrono::nanoseconds Tracer::GetLambdaThreshold() const {
+    return options_.lambda_threshold;
+}
+
+size_t Tracer::GetDroppedEvents() const {
+    return dropped_;
+}
+
+TraceBuffer* Tracer::GetBuffer() {
+    if (buffer_session != session_) {
+        thread_buffer = std::make_shared<TraceBuffer>(options_.buffer_events, GetThreadId());
+        buffer_session = session_;
+        std::lock_guard lock(buffers_mutex_);
+        buffers_.push_back(thread_buffer);
+    }
+    return thread_buffer.get();
+}
+
+void Tracer::Flush() {
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    {
+        std::lock_guard lock(buffers_mutex_);
+        buffers = buffers_;
+    }
+    static const int pid = getpid();
+    std::string text;
+    char line[160];
+    for (const auto& buffer : buffers) {
+        buffer->Drain([&](const TraceEvent& event) {
+            text += first_event_ ? "\n{\"name\":\"" : ",\n{\"name\":\"";
+            first_event_ = false;
+            AppendEscaped(event.name, &text);
+            // Timestamps are in microseconds.
+            std::snprintf(line, sizeof(line),
+                          "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,"
+                          "\"tid\":%u}",
+                          event.category, event.start_ns / 1e3, event.duration_ns / 1e3, pid,
+                          buffer->GetThreadId());
+            text += line;
+        });
+    }
+    out_ << text << std::flush;
+}
+
+void Tracer::FlushLoop() {
+    std::unique_lock lock(flush_mutex_);
+    while (!stopping_) {
+        wake_.wait_for(lock, options_.flush_interval);
+        lock.unlock();
+        Flush();
+        lock.lock();
+    }
+}
+
+void LambdaSpan::Finish() {
+    auto end = std::chrono::steady_clock::now();
+    if (end - start_ >= tracer_->GetLambdaThreshold()) {
+        std::string_view name = "lambda";
+        if (auto symbol = As<Symbol>(name_)) {
+            name = symbol->GetName();
+        }
+        tracer_->Add("lambda", name, start_, end);
+    }
+}
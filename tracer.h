@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+class Object;
+
+struct TraceOptions {
+    // Calls of lambdas shorter than this are left out; everything else is always recorded.
+    std::chrono::nanoseconds lambda_threshold{std::chrono::microseconds(100)};
+    // Events a thread may have buffered; more are dropped until the writer catches up.
+    size_t buffer_events{1 << 14};
+    std::chrono::milliseconds flush_interval{50};
+};
+
+// A finished span, as buffered until it is written.
+struct TraceEvent {
+    const char* category;
+    char name[48];
+    int64_t start_ns;
+    int64_t duration_ns;
+};
+
+// Single-producer single-consumer ring of events: the thread recording them and the writer.
+class TraceBuffer {
+public:
+    TraceBuffer(size_t capacity, uint32_t tid);
+
+    // False if the buffer is full.
+    bool Push(const TraceEvent& event);
+
+    // Calls write for every buffered event, oldest first, and frees their slots.
+    template <class F>
+    void Drain(F write) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        auto head = head_.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            write(events_[tail & mask_]);
+        }
+        tail_.store(tail, std::memory_order_release);
+    }
+
+    uint32_t GetThreadId() const;
+
+private:
+    std::vector<TraceEvent> events_;
+    size_t mask_;
+    uint32_t tid_;
+    std::atomic<size_t> head_{0};
+    std::atomic<size_t> tail_{0};
+};
+
+// While alive, records spans of parsing, evaluation of top-level forms, slow lambda calls and
+// collection phases on every thread, and writes them to path as Chrome trace-event JSON
+// (chrome://tracing, Perfetto). Recording a span only appends to a buffer of the thread; a
+// background thread writes the buffers out every flush interval.
+//
+// Only one tracer may be alive at a time, and it must outlive the evaluations running while it
+// is destroyed.
+class Tracer {
+public:
+    explicit Tracer(const std::string& path, const TraceOptions& options = TraceOptions{});
+
+    ~Tracer();
+
+    Tracer(const Tracer&) = delete;
+
+    Tracer& operator=(const Tracer&) = delete;
+
+    // The live tracer, nullptr when tracing is off.
+    static Tracer* GetActive() {
+        return active.load(std::memory_order_acquire);
+    }
+
+    void Add(const char* category, std::string_view name,
+             std::chrono::steady_clock::time_point start,
+             std::chrono::steady_clock::time_point end);
+
+    std::chrono::nanoseconds GetLambdaThreshold() const;
+
+    // Events lost to full buffers.
+    size_t GetDroppedEvents() const;
+
+private:
+    static std::atomic<Tracer*> active;
+    // Set from before a tracer opens its file until it has closed it, so that a second tracer
+    // fails without touching any file.
+    static std::atomic<bool> claimed;
+
+    TraceBuffer* GetBuffer();
+
+    void Flush();
+
+    void FlushLoop();
+
+    TraceOptions options_;
+    uint64_t session_;
+    std::chrono::steady_clock::time_point origin_;
+    std::ofstream out_;
+    bool first_event_{true};
+    std::atomic<size_t> dropped_{0};
+
+    std::mutex buffers_mutex_;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers_;
+
+    std::mutex flush_mutex_;
+    std::condition_variable wake_;
+    bool stopping_{false};
+    std::thread writer_;
+};
+
+// Records the time from its construction to its destruction as a span, if a tracer is alive.
+// name must stay valid for as long as the span.
+class TraceSpan {
+public:
+    TraceSpan(const char* category, std::string_view name)
+        : tracer_{Tracer::GetActive()}, category_{category}, name_{name} {
+        if (tracer_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~TraceSpan() {
+        if (tracer_) {
+            tracer_->Add(category_, name_, start_, std::chrono::steady_clock::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    Tracer* tracer_;
+    const char* category_;
+    std::string_view name_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Span of a lambda call, recorded only if it lasted at least the lambda threshold. name is the
+// Symbol the lambda was defined as, nullptr for an anonymous one.
+class LambdaSpan {
+public:
+    LambdaSpan(Object* name) : tracer_{Tracer::GetActive()}, name_{name} {
+        if (tracer_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~LambdaSpan() {
+        if (tracer_) {
+            Finish();
+        }
+    }
+
+    LambdaSpan(const LambdaSpan&) = delete;
+
+    LambdaSpan& operator=(const LambdaSpan&) = delete;
+
+private:
+    void Finish();
+
+    Tracer* tracer_;
+    Object* name_;
+    std::chrono::steady_clock::time_point start_;
+};